@@ -0,0 +1,211 @@
+// Sub-pixel accuracy and speed of the laser dot center modes at each
+// downscale: synthetic dots at known sub-pixel positions go through
+// ImageModifier, LaserDetector and PointModifier, as in the application.
+//
+// Usage: center_benchmark [nb_frames_per_configuration]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+#include <QObject>
+#include <QImage>
+#include <QPointF>
+#include <QRect>
+#include <QSize>
+#include <QElapsedTimer>
+
+#include "opencv2/core/core.hpp"
+
+#include "image_modifier.h"
+#include "laser_detector.h"
+#include "point_modifier.h"
+
+using namespace laser_painter;
+
+namespace {
+
+const int frame_width = 1280;
+const int frame_height = 720;
+const int nb_backgrounds = 8;
+const double background_level = 30.;
+const double noise_sigma = 2.;
+const double dot_sigma = 2.5; // pixels at the camera resolution
+
+// Keep the last point emitted by PointModifier.
+class PointRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    PointRecorder() : found(false) {}
+
+public slots:
+    void record(const QPointF& pos, bool pos_found)
+    {
+        point = pos;
+        found = pos_found;
+    }
+
+public:
+    QPointF point;
+    bool found;
+};
+
+QImage noisyBackground(cv::RNG& rng)
+{
+    QImage image(frame_width, frame_height, QImage::Format_RGB888);
+    for(int i = 0; i < image.height(); ++i) {
+        uchar* pixel = image.scanLine(i);
+        for(int j = 0; j < 3 * image.width(); ++j, ++pixel)
+            *pixel = cv::saturate_cast<uchar>(background_level + rng.gaussian(noise_sigma));
+    }
+    return image;
+}
+
+// Add a Gaussian dot of @param amplitude (values above 255 saturate)
+// centered at @param center (pixel centers are at integer coordinates).
+void drawDot(QImage& image, const QPointF& center, double amplitude)
+{
+    const int radius = static_cast<int>(std::ceil(4 * dot_sigma));
+    const int x0 = static_cast<int>(std::floor(center.x()));
+    const int y0 = static_cast<int>(std::floor(center.y()));
+    for(int i = qMax(0, y0 - radius); i <= qMin(image.height() - 1, y0 + radius); ++i) {
+        uchar* line = image.scanLine(i);
+        for(int j = qMax(0, x0 - radius); j <= qMin(image.width() - 1, x0 + radius); ++j) {
+            const double dx = j - center.x();
+            const double dy = i - center.y();
+            const double value = amplitude * std::exp(-(dx * dx + dy * dy) / (2 * dot_sigma * dot_sigma));
+            // Reddish dot: the red channel is the brightest.
+            uchar* rgb = line + 3 * j;
+            rgb[0] = cv::saturate_cast<uchar>(rgb[0] + value);
+            rgb[1] = cv::saturate_cast<uchar>(rgb[1] + 0.8 * value);
+            rgb[2] = cv::saturate_cast<uchar>(rgb[2] + 0.8 * value);
+        }
+    }
+}
+
+const char* scaleModeName(ImageModifier::ScaleMode mode)
+{
+    switch(mode) {
+    case ImageModifier::NearestScale:
+        return "nearest";
+    case ImageModifier::PeakScale:
+        return "peak";
+    case ImageModifier::AreaScale:
+        return "area";
+    }
+    return "";
+}
+
+const char* centerModeName(LaserDetector::CenterMode mode)
+{
+    switch(mode) {
+    case LaserDetector::ContourCenter:
+        return "contour";
+    case LaserDetector::WeightedCenter:
+        return "weighted";
+    case LaserDetector::GaussianCenter:
+        return "gaussian";
+    }
+    return "";
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const int nb_frames = argc > 1 ? std::atoi(argv[1]) : 500;
+    if(nb_frames <= 0) {
+        std::fprintf(stderr, "Usage: %s [nb_frames_per_configuration]\n", argv[0]);
+        return 1;
+    }
+
+    cv::RNG rng(0x1a5e7);
+    std::vector<QImage> backgrounds;
+    for(int k = 0; k < nb_backgrounds; ++k)
+        backgrounds.push_back(noisyBackground(rng));
+
+    // Dot positions at known sub-pixel offsets, the same for all
+    // configurations
+    std::vector<QPointF> centers;
+    for(int k = 0; k < nb_frames; ++k)
+        centers.push_back(QPointF(
+            rng.uniform(0.1 * frame_width, 0.9 * frame_width),
+            rng.uniform(0.1 * frame_height, 0.9 * frame_height)
+        ));
+
+    const double scales[] = {1., 1. / 2, 1. / 3, 1. / 4};
+    const ImageModifier::ScaleMode scale_modes[] = {ImageModifier::PeakScale, ImageModifier::AreaScale};
+    const LaserDetector::CenterMode center_modes[] = {
+        LaserDetector::ContourCenter, LaserDetector::WeightedCenter, LaserDetector::GaussianCenter
+    };
+    // Unsaturated and saturated dot cores
+    const double amplitudes[] = {180., 600.};
+
+    std::printf("%d frames %dx%d per configuration, dot sigma %.1f px, errors in camera pixels\n",
+        nb_frames, frame_width, frame_height, dot_sigma);
+    std::printf("%-9s %-6s %-8s %-9s %6s %9s %9s %8s %8s %9s\n",
+        "amplitude", "scale", "mode", "center", "found", "mean_err", "p95_err", "bias_x", "bias_y", "ms/frame");
+
+    for(size_t a = 0; a < sizeof(amplitudes) / sizeof(amplitudes[0]); ++a)
+    for(size_t s = 0; s < sizeof(scales) / sizeof(scales[0]); ++s)
+    for(size_t m = 0; m < sizeof(scale_modes) / sizeof(scale_modes[0]); ++m)
+    for(size_t c = 0; c < sizeof(center_modes) / sizeof(center_modes[0]); ++c) {
+        ImageModifier image_modifier;
+        image_modifier.setScale(scales[s]);
+        image_modifier.setScaleMode(scale_modes[m]);
+        LaserDetector laser_detector;
+        laser_detector.setCenterMode(center_modes[c]);
+        laser_detector.setSkipStaticFrames(false);
+        PointModifier point_modifier;
+        point_modifier.setUnscale(scales[s]);
+        point_modifier.setROI(QRect(0, 0, frame_width, frame_height), QSize(frame_width, frame_height));
+        PointRecorder recorder;
+        QObject::connect(&image_modifier, &ImageModifier::imageAvailable, &laser_detector, &LaserDetector::run);
+        QObject::connect(&laser_detector, &LaserDetector::laserPosition, &point_modifier, &PointModifier::run);
+        QObject::connect(&point_modifier, &PointModifier::pointAvailable, &recorder, &PointRecorder::record);
+
+        std::vector<double> errors;
+        double bias_x = 0., bias_y = 0.;
+        qint64 nsecs = 0;
+        for(int k = 0; k < nb_frames; ++k) {
+            QImage frame = backgrounds[k % nb_backgrounds].copy();
+            drawDot(frame, centers[k], amplitudes[a]);
+
+            recorder.found = false;
+            QElapsedTimer timer;
+            timer.start();
+            image_modifier.run(frame);
+            nsecs += timer.nsecsElapsed();
+            if(!recorder.found)
+                continue;
+
+            const QPointF error = recorder.point - centers[k];
+            errors.push_back(std::sqrt(error.x() * error.x() + error.y() * error.y()));
+            bias_x += error.x();
+            bias_y += error.y();
+        }
+
+        double mean_error = 0., p95_error = 0.;
+        if(!errors.empty()) {
+            for(size_t k = 0; k < errors.size(); ++k)
+                mean_error += errors[k];
+            mean_error /= errors.size();
+            bias_x /= errors.size();
+            bias_y /= errors.size();
+            std::sort(errors.begin(), errors.end());
+            p95_error = errors[std::min(errors.size() - 1, static_cast<size_t>(0.95 * errors.size()))];
+        }
+        std::printf("%-9.0f %-6.3f %-8s %-9s %5.1f%% %9.3f %9.3f %8.3f %8.3f %9.3f\n",
+            amplitudes[a], scales[s], scaleModeName(scale_modes[m]), centerModeName(center_modes[c]),
+            100. * errors.size() / nb_frames, mean_error, p95_error, bias_x, bias_y,
+            nsecs / 1e6 / nb_frames);
+    }
+
+    return 0;
+}
+
+#include "center_benchmark.moc"
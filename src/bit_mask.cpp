@@ -0,0 +1,272 @@
+#include "bit_mask.h"
+
+#include <QtAlgorithms>
+#include <cmath>
+
+namespace laser_painter {
+
+BitMask::Kernel BitMask::ellipse(int size)
+{
+    Q_ASSERT(size > 0);
+
+    // As in cv::getStructuringElement(), anchored at the center
+    const int r = size / 2;
+    const int c = size / 2;
+    const double inv_r2 = r ? 1. / (r * r) : 0.;
+    Kernel kernel;
+    for(int i = 0; i < size; ++i) {
+        const int dy = i - r;
+        if(qAbs(dy) > r)
+            continue;
+        const int dx = static_cast<int>(std::lrint(c * std::sqrt((r * r - dy * dy) * inv_r2)));
+        const int begin = qMax(c - dx, 0);
+        const int end = qMin(c + dx + 1, size);
+        if(begin >= end)
+            continue;
+        const KernelRow row = {dy, begin - c, end - 1 - c};
+        kernel.append(row);
+    }
+    return kernel;
+}
+
+BitMask::Kernel BitMask::diamond(int radius)
+{
+    Q_ASSERT(radius >= 0);
+
+    Kernel kernel;
+    for(int dy = -radius; dy <= radius; ++dy) {
+        const int dx = radius - qAbs(dy);
+        const KernelRow row = {dy, -dx, dx};
+        kernel.append(row);
+    }
+    return kernel;
+}
+
+int BitMask::reach(const Kernel& kernel)
+{
+    int reach = 0;
+    for(int i = 0, size = kernel.size(); i < size; ++i)
+        reach = qMax(reach, qMax(qAbs(kernel[i].dy), qMax(qAbs(kernel[i].begin), qAbs(kernel[i].end))));
+    return reach;
+}
+
+BitMask::BitMask()
+    : _width(0),
+    _height(0),
+    _words_per_row(0),
+    _tail_mask(0)
+{}
+
+void BitMask::create(int width, int height)
+{
+    Q_ASSERT(width >= 0 && height >= 0);
+
+    _width = width;
+    _height = height;
+    _words_per_row = (width + 63) / 64;
+    _tail_mask = width % 64 == 0 ? ~quint64(0) : (quint64(1) << (width % 64)) - 1;
+    _words.fill(0, _words_per_row * height);
+}
+
+int BitMask::width() const
+{
+    return _width;
+}
+
+int BitMask::height() const
+{
+    return _height;
+}
+
+void BitMask::fromBytes(const uchar* data, int width, int height, int bytes_per_line)
+{
+    create(width, height);
+    for(int y = 0; y < height; ++y) {
+        const uchar* bytes = data + y * bytes_per_line;
+        quint64* words = row(y);
+        for(int x = 0; x < width; ++x)
+            if(bytes[x])
+                words[x >> 6] |= quint64(1) << (x & 63);
+    }
+}
+
+void BitMask::toBytes(uchar* data, int bytes_per_line) const
+{
+    for(int y = 0; y < _height; ++y) {
+        uchar* bytes = data + y * bytes_per_line;
+        const quint64* words = row(y);
+        for(int x = 0; x < _width; ++x)
+            bytes[x] = (words[x >> 6] >> (x & 63)) & 1 ? 255 : 0;
+    }
+}
+
+void BitMask::fillSpan(int y, int begin, int end)
+{
+    Q_ASSERT(y >= 0 && y < _height);
+    Q_ASSERT(begin >= 0 && begin <= end && end <= _width);
+
+    quint64* words = row(y);
+    while(begin < end) {
+        const int bit = begin % 64;
+        const int nb_bits = qMin(64 - bit, end - begin);
+        words[begin / 64] |= (nb_bits == 64 ? ~quint64(0) : (quint64(1) << nb_bits) - 1) << bit;
+        begin += nb_bits;
+    }
+}
+
+void BitMask::subtract(const BitMask& other)
+{
+    Q_ASSERT(other._width == _width && other._height == _height);
+
+    const quint64* other_word = other._words.constData();
+    for(quint64* word = _words.data(), * end = word + _words.size(); word < end; ++word, ++other_word)
+        *word &= ~*other_word;
+}
+
+void BitMask::intersect(const BitMask& other)
+{
+    Q_ASSERT(other._width == _width && other._height == _height);
+
+    const quint64* other_word = other._words.constData();
+    for(quint64* word = _words.data(), * end = word + _words.size(); word < end; ++word, ++other_word)
+        *word &= *other_word;
+}
+
+void BitMask::dilate(const Kernel& kernel, BitMask& result) const
+{
+    morphology(kernel, true, result);
+}
+
+void BitMask::erode(const Kernel& kernel, BitMask& result) const
+{
+    morphology(kernel, false, result);
+}
+
+void BitMask::close(const Kernel& kernel, BitMask& buffer)
+{
+    dilate(kernel, buffer);
+    buffer.erode(kernel, *this);
+}
+
+int BitMask::count() const
+{
+    int count = 0;
+    for(const quint64* word = _words.constData(), * end = word + _words.size(); word < end; ++word)
+        count += qPopulationCount(*word);
+    return count;
+}
+
+int BitMask::countAnd(const BitMask& other) const
+{
+    Q_ASSERT(other._width == _width && other._height == _height);
+
+    int count = 0;
+    const quint64* other_word = other._words.constData();
+    for(const quint64* word = _words.constData(), * end = word + _words.size(); word < end; ++word, ++other_word)
+        count += qPopulationCount(*word & *other_word);
+    return count;
+}
+
+void BitMask::morphology(const Kernel& kernel, bool dilating, BitMask& result) const
+{
+    Q_ASSERT(&result != this);
+
+    // Outside pixels are neutral: they don't dilate, nor erode.
+    const quint64 outside = dilating ? 0 : ~quint64(0);
+    result.create(_width, _height);
+    for(int y = 0; y < _height; ++y) {
+        quint64* result_row = result.row(y);
+        for(int k = 0; k < _words_per_row; ++k)
+            result_row[k] = outside;
+
+        for(int i = 0, size = kernel.size(); i < size; ++i) {
+            const KernelRow& kernel_row = kernel[i];
+            const int source_y = y + kernel_row.dy;
+            if(source_y < 0 || source_y >= _height)
+                continue;
+            // Pixel x of the result combines pixels x + dx of the source row.
+            for(int dx = kernel_row.begin; dx <= kernel_row.end; ++dx)
+                for(int k = 0; k < _words_per_row; ++k) {
+                    const quint64 source = bits(source_y, k * 64 + dx, outside);
+                    if(dilating)
+                        result_row[k] |= source;
+                    else
+                        result_row[k] &= source;
+                }
+        }
+        if(_words_per_row > 0)
+            result_row[_words_per_row - 1] &= _tail_mask;
+    }
+}
+
+quint64 BitMask::bits(int y, int offset, quint64 outside) const
+{
+    const quint64* words = row(y);
+    // Word index and bit shift, rounded down for negative offsets
+    const int k = offset >= 0 ? offset / 64 : -((63 - offset) / 64);
+    const int shift = offset - k * 64;
+    quint64 low = outside;
+    quint64 high = outside;
+    if(k >= 0 && k < _words_per_row) {
+        low = words[k];
+        if(k == _words_per_row - 1)
+            low = (low & _tail_mask) | (outside & ~_tail_mask);
+    }
+    if(k + 1 >= 0 && k + 1 < _words_per_row) {
+        high = words[k + 1];
+        if(k + 1 == _words_per_row - 1)
+            high = (high & _tail_mask) | (outside & ~_tail_mask);
+    }
+    return shift == 0 ? low : (low >> shift) | (high << (64 - shift));
+}
+
+namespace {
+
+// Add @param rect to @param rects, merged with the ones closer than
+// @param distance.
+void addRect(QVector<QRect>& rects, QRect rect, int distance)
+{
+    for(int i = 0; i < rects.size();) {
+        if(rects[i].adjusted(-distance, -distance, distance, distance).intersects(rect)) {
+            // The merged rect can reach the previous ones.
+            rect |= rects[i];
+            rects.remove(i);
+            i = 0;
+        } else
+            ++i;
+    }
+    rects.append(rect);
+}
+
+} // namespace
+
+bool BitMask::boundingRects(int distance, int max_count, QVector<QRect>& rects) const
+{
+    rects.clear();
+    for(int y = 0; y < _height; ++y) {
+        const quint64* words = row(y);
+        // Runs of set pixels [begin, x)
+        int begin = -1;
+        for(int k = 0; k < _words_per_row; ++k) {
+            const quint64 word = words[k];
+            if((begin < 0 && word == 0) || (begin >= 0 && word == ~quint64(0)))
+                continue;
+            for(int x = k * 64, end = qMin(x + 64, _width); x < end; ++x) {
+                const bool set = (word >> (x & 63)) & 1;
+                if(set && begin < 0)
+                    begin = x;
+                else if(!set && begin >= 0) {
+                    addRect(rects, QRect(begin, y, x - begin, 1), distance);
+                    begin = -1;
+                }
+            }
+            if(rects.size() > max_count)
+                return false;
+        }
+        if(begin >= 0)
+            addRect(rects, QRect(begin, y, _width - begin, 1), distance);
+    }
+    return rects.size() <= max_count;
+}
+
+} // namespace laser_painter
@@ -0,0 +1,113 @@
+#ifndef BIT_MASK
+#define BIT_MASK
+
+#include <QtGlobal>
+#include <QVector>
+#include <QRect>
+
+namespace laser_painter {
+
+/// Binary image with one bit per pixel, packed in 64-bit words: pixel x of
+/// a row is the bit x % 64 of the word x / 64 of the row. Operations
+/// process whole words. Bits beyond the width are always zero.
+class BitMask
+{
+public:
+    /// Row of a structuring element: pixels [begin, end] (inclusive) of
+    /// the row dy, relatively to the anchor.
+    struct KernelRow {
+        int dy;
+        int begin;
+        int end;
+    };
+    typedef QVector<KernelRow> Kernel;
+
+    /// Ellipse of @param size, the same as
+    /// cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(size, size)).
+    static Kernel ellipse(int size);
+    /// Diamond of @param radius, the same as @param radius iterations of
+    /// the 3x3 cross.
+    static Kernel diamond(int radius);
+    /// Largest offset (in rows or columns) of @param kernel.
+    static int reach(const Kernel& kernel);
+
+    BitMask();
+
+    /// Resize the mask to @param width x @param height and clear it.
+    void create(int width, int height);
+
+    int width() const;
+    int height() const;
+    inline quint64* row(int y);
+    inline const quint64* row(int y) const;
+    inline bool at(int x, int y) const;
+
+    /// Set the mask to nonzero pixels of the 8-bit image @param data of
+    /// @param width x @param height and @param bytes_per_line.
+    void fromBytes(const uchar* data, int width, int height, int bytes_per_line);
+    /// Write the mask to the 8-bit image @param data of the mask size and
+    /// @param bytes_per_line, set pixels are 255, others 0.
+    void toBytes(uchar* data, int bytes_per_line) const;
+
+    /// Set pixels [@param begin, @param end) of the row @param y.
+    void fillSpan(int y, int begin, int end);
+    /// Remove pixels of @param other (of the same size).
+    void subtract(const BitMask& other);
+    /// Keep only pixels of @param other (of the same size).
+    void intersect(const BitMask& other);
+
+    /// Dilate and erode by @param kernel into @param result. Pixels outside
+    /// the mask are ignored, as by the cv::dilate() and cv::erode() default
+    /// border.
+    void dilate(const Kernel& kernel, BitMask& result) const;
+    void erode(const Kernel& kernel, BitMask& result) const;
+    /// Morphological closing by @param kernel, in place. @param buffer
+    /// holds the dilated mask.
+    void close(const Kernel& kernel, BitMask& buffer);
+
+    /// Bounding rects @param rects of set pixels, merged while they are
+    /// less than @param distance pixels apart (rects enlarged by
+    /// @param distance intersect).
+    /// @return false if there are more than @param max_count rects.
+    bool boundingRects(int distance, int max_count, QVector<QRect>& rects) const;
+
+    /// Number of set pixels
+    int count() const;
+    /// Number of pixels set in this mask and in @param other.
+    int countAnd(const BitMask& other) const;
+
+private:
+    // Combine (OR if dilating, AND otherwise) rows of this mask shifted by
+    // offsets of @param kernel into @param result.
+    void morphology(const Kernel& kernel, bool dilating, BitMask& result) const;
+    // Bits [offset, offset + 64) of the row @param y, @param outside for
+    // pixels outside of the mask.
+    inline quint64 bits(int y, int offset, quint64 outside) const;
+
+private:
+    int _width;
+    int _height;
+    int _words_per_row;
+    // Valid bits of the last word of rows
+    quint64 _tail_mask;
+    QVector<quint64> _words;
+};
+
+quint64* BitMask::row(int y)
+{
+    return _words.data() + y * _words_per_row;
+}
+
+const quint64* BitMask::row(int y) const
+{
+    return _words.constData() + y * _words_per_row;
+}
+
+bool BitMask::at(int x, int y) const
+{
+    return (row(y)[x >> 6] >> (x & 63)) & 1;
+}
+
+} // namespace laser_painter
+
+#endif // BIT_MASK
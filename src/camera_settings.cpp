@@ -82,14 +82,14 @@ CameraSettings::CameraSettings(
     resolution_lb->setBuddy(_resolution_cb);
 
     _flip_x_cb = new QCheckBox();
-    connect(_flip_x_cb, &QCheckBox::toggled, video_frame_grabber, &VideoFrameGrabber::setFlipX);
+    connect(_flip_x_cb, &QCheckBox::toggled, this, &CameraSettings::emitFlipChanged);
     _flip_x_cb->setChecked(settings.value("CameraSettings/flip_x", true).toBool());
     QLabel* flip_x_lb = new QLabel(tr("Flip X:"));
     flip_x_lb->setToolTip(tr("Horizontal flip"));
     flip_x_lb->setBuddy(_flip_x_cb);
 
     _flip_y_cb = new QCheckBox();
-    connect(_flip_y_cb, &QCheckBox::toggled, video_frame_grabber, &VideoFrameGrabber::setFlipY);
+    connect(_flip_y_cb, &QCheckBox::toggled, this, &CameraSettings::emitFlipChanged);
     _flip_y_cb->setChecked(settings.value("CameraSettings/flip_y", false).toBool());
     QLabel* flip_y_lb = new QLabel(tr("Flip Y:"));
     flip_y_lb->setToolTip(tr("Vertical flip"));
@@ -133,6 +133,11 @@ void CameraSettings::writeSettings() const
     settings.endGroup();
 }
 
+void CameraSettings::emitFlipChanged() const
+{
+    emit flipChanged(_flip_x_cb->isChecked(), _flip_y_cb->isChecked());
+}
+
 QSize CameraSettings::currentResolution() const
 {
     if(!_camera_image_capture)
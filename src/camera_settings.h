@@ -30,9 +30,17 @@ public:
 signals:
     void cameraChanged(QCamera* camera);
     void resolutionChanged(const QSize& resolution);
+    /// Camera frames should be shown flipped horizontally if @param flip_x
+    /// and vertically if @param flip_y.
+    void flipChanged(bool flip_x, bool flip_y) const;
 
 public:
     QSize currentResolution() const;
+
+public slots:
+    // Emits a flipChanged() signal with the current flips
+    void emitFlipChanged() const;
+
 private slots:
     // Update available cameras and set a default camera (if any) or a first
     // available camera (if any) if @param try_set_camera is true.
@@ -0,0 +1,181 @@
+#include "canvas_exporter.h"
+
+#include <QFile>
+#include <QImage>
+#include <QPainter>
+#include <QPolygonF>
+#include <QThread>
+
+#include "stroke_log_codec.h"
+#include "tiff_strip_writer.h"
+
+namespace laser_painter {
+
+CanvasExporter::CanvasExporter(QObject* parent)
+    : QObject(parent)
+{}
+
+void CanvasExporter::run(
+    const QString& log_path,
+    const QString& image_path,
+    int width,
+    const QColor& track_color,
+    int track_width,
+    const QColor& canvas_color
+)
+{
+    Q_ASSERT(width > 0);
+
+    QFile file(log_path);
+    uchar* data = file.open(QIODevice::ReadOnly) ? file.map(0, file.size()) : 0;
+    if(!data) {
+        emit warning(tr("Export: cannot read %1").arg(log_path));
+        emit finished(false);
+        return;
+    }
+    StrokeLogDecoder decoder(data, file.size());
+    if(!decoder.isValid()) {
+        emit warning(tr("Export: %1 is not a valid stroke log").arg(log_path));
+        emit finished(false);
+        return;
+    }
+
+    // Index strokes: only offsets and bounding rects are kept in memory.
+    // Strokes are rescaled to the first known canvas size.
+    QSize canvas_size = decoder.headerCanvasSize();
+    QSize reference_canvas_size = canvas_size;
+    QVector<Stroke> strokes;
+    Stroke stroke;
+    bool in_stroke = false;
+    qreal x_min = 0, x_max = 0, y_min = 0, y_max = 0;
+    for(;;) {
+        const qint64 record_offset = decoder.offset();
+        const stroke_log::RecordType type = decoder.next();
+
+        if(in_stroke && type != stroke_log::StrokePoint) {
+            stroke.rect = QRectF(
+                QPointF(x_min, y_min) * stroke.scale,
+                QPointF(x_max, y_max) * stroke.scale
+            );
+            strokes.append(stroke);
+            in_stroke = false;
+        }
+
+        if(type == stroke_log::EndOfLog || type == stroke_log::InvalidRecord)
+            break;
+
+        const QPointF pos = decoder.pos();
+        switch(type) {
+        case stroke_log::CanvasSize:
+            canvas_size = decoder.canvasSize();
+            if(reference_canvas_size.isEmpty())
+                reference_canvas_size = canvas_size;
+            break;
+        case stroke_log::StrokeBegin:
+            stroke.offset = record_offset;
+            stroke.scale = canvas_size.isEmpty() || reference_canvas_size.isEmpty() ?
+                1. : static_cast<qreal>(reference_canvas_size.width()) / canvas_size.width();
+            x_min = x_max = pos.x();
+            y_min = y_max = pos.y();
+            in_stroke = true;
+            break;
+        case stroke_log::StrokePoint:
+            x_min = qMin(x_min, pos.x());
+            x_max = qMax(x_max, pos.x());
+            y_min = qMin(y_min, pos.y());
+            y_max = qMax(y_max, pos.y());
+            break;
+        default:
+            break;
+        }
+    }
+
+    if(reference_canvas_size.isEmpty()) {
+        emit warning(tr("Export: unknown canvas size"));
+        emit finished(false);
+        return;
+    }
+
+    const qreal scale = static_cast<qreal>(width) / reference_canvas_size.width();
+    const int height = qMax(1, qRound(scale * reference_canvas_size.height()));
+    const int band_height = qBound(1, _band_size_max / (4 * width), height);
+
+    TiffStripWriter writer;
+    if(!writer.open(image_path, width, height, band_height)) {
+        emit warning(tr("Export: %1").arg(writer.errorString()));
+        emit finished(false);
+        return;
+    }
+
+    QPen pen(track_color);
+    pen.setJoinStyle(Qt::RoundJoin);
+    pen.setCapStyle(Qt::RoundCap);
+    pen.setWidthF(qMax<qreal>(1., track_width * scale));
+    // Stroke margin in canvas coordinates
+    const qreal margin = pen.widthF() / scale;
+
+    QImage band(width, band_height, QImage::Format_RGB32);
+    QPolygonF polyline;
+    int percent = -1;
+    for(int top = 0; top < height; top += band_height) {
+        if(QThread::currentThread()->isInterruptionRequested()) {
+            emit warning(tr("Export: interrupted"));
+            emit finished(false);
+            return;
+        }
+
+        band.fill(canvas_color);
+        QPainter painter(&band);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setPen(pen);
+        painter.translate(0, -top);
+        painter.scale(scale, scale);
+
+        const qreal band_top = top / scale - margin;
+        const qreal band_bottom = (top + band_height) / scale + margin;
+        for(int i = 0, size = strokes.size(); i < size; ++i) {
+            const Stroke& s = strokes[i];
+            if(s.rect.bottom() < band_top || s.rect.top() > band_bottom)
+                continue;
+
+            polyline.clear();
+            decoder.seek(s.offset);
+            for(;;) {
+                const stroke_log::RecordType type = decoder.next();
+                if(type != stroke_log::StrokeBegin && type != stroke_log::StrokePoint)
+                    break;
+                if(type == stroke_log::StrokeBegin && !polyline.isEmpty())
+                    break;
+                polyline.append(decoder.pos() * s.scale);
+            }
+
+            if(polyline.size() == 1)
+                painter.drawPoint(polyline.first());
+            else
+                painter.drawPolyline(polyline);
+        }
+        painter.end();
+
+        if(!writer.writeStrip(band)) {
+            emit warning(tr("Export: %1").arg(writer.errorString()));
+            emit finished(false);
+            return;
+        }
+
+        const int new_percent = 100 * qMin(height, top + band_height) / height;
+        if(new_percent != percent) {
+            percent = new_percent;
+            emit progress(percent);
+        }
+    }
+
+    if(!writer.close()) {
+        emit warning(tr("Export: %1").arg(writer.errorString()));
+        emit finished(false);
+        return;
+    }
+
+    emit finished(true);
+}
+
+} // namespace laser_painter
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef CANVAS_EXPORTER
+#define CANVAS_EXPORTER
+
+#include <QObject>
+#include <QColor>
+#include <QRectF>
+#include <QVector>
+
+namespace laser_painter {
+
+/// Render all the strokes of a stroke log into a (large) TIFF image.
+/// The image is rendered and written band by band, so the memory usage
+/// doesn't depend on the image size. Designed to run in a worker thread.
+class CanvasExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CanvasExporter(QObject* parent = 0);
+
+public slots:
+    /// Render the strokes of the log @param log_path into the TIFF image
+    /// @param image_path of width @param width (the height keeps the canvas
+    /// aspect ratio). Track width @param track_width is in canvas pixels.
+    void run(
+        const QString& log_path,
+        const QString& image_path,
+        int width,
+        const QColor& track_color,
+        int track_width,
+        const QColor& canvas_color
+    );
+
+signals:
+    /// Export progress @param percent in [0, 100].
+    void progress(int percent) const;
+    void finished(bool success) const;
+
+    void warning(const QString& text) const;
+
+private:
+    struct Stroke {
+        // Offset of the StrokeBegin record in the log
+        qint64 offset;
+        // Scale from the stroke canvas to the reference canvas
+        qreal scale;
+        // Bounding rect in the reference canvas coordinates
+        QRectF rect;
+    };
+
+private:
+    // Maximum memory for a rendered band
+    static const int _band_size_max = 32 * 1024 * 1024; // bytes
+};
+
+} // namespace laser_painter
+
+#endif // CANVAS_EXPORTER
\ No newline at end of file
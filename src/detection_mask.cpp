@@ -0,0 +1,78 @@
+#include "detection_mask.h"
+
+#include <QImage>
+#include <QPainter>
+#include <QTransform>
+
+namespace laser_painter {
+
+DetectionMask::DetectionMask()
+    : _size(),
+    _full(true)
+{}
+
+void DetectionMask::compile(
+    const QVector<QPolygonF>& include,
+    const QVector<QPolygonF>& exclude,
+    const QTransform& transform,
+    const QSize& size
+)
+{
+    _size = size;
+    _full = include.isEmpty() && exclude.isEmpty();
+    _spans.clear();
+    _row_offsets.resize(size.height() + 1);
+
+    if(_full) {
+        const Span span = {0, size.width()};
+        _spans.fill(span, size.height());
+        for(int i = 0; i <= size.height(); ++i)
+            _row_offsets[i] = i;
+        return;
+    }
+
+    // Rasterize polygons, then scan rows.
+    QImage raster(size, QImage::Format_RGB32);
+    raster.fill(include.isEmpty() ? Qt::white : Qt::black);
+    {
+        QPainter painter(&raster);
+        painter.setPen(Qt::NoPen);
+        painter.setTransform(transform);
+        painter.setBrush(Qt::white);
+        foreach(const QPolygonF& polygon, include)
+            painter.drawPolygon(polygon);
+        painter.setBrush(Qt::black);
+        foreach(const QPolygonF& polygon, exclude)
+            painter.drawPolygon(polygon);
+    }
+
+    for(int i = 0; i < size.height(); ++i) {
+        _row_offsets[i] = _spans.size();
+        const QRgb* line = reinterpret_cast<const QRgb*>(raster.constScanLine(i));
+        for(int j = 0; j < size.width(); ) {
+            // Skip inactive pixels
+            while(j < size.width() && qRed(line[j]) == 0)
+                ++j;
+            if(j == size.width())
+                break;
+            Span span = {j, j};
+            while(j < size.width() && qRed(line[j]) != 0)
+                ++j;
+            span.end = j;
+            _spans.append(span);
+        }
+    }
+    _row_offsets[size.height()] = _spans.size();
+}
+
+const QSize& DetectionMask::size() const
+{
+    return _size;
+}
+
+bool DetectionMask::isFull() const
+{
+    return _full;
+}
+
+} // namespace laser_painter
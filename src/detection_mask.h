@@ -0,0 +1,65 @@
+#ifndef DETECTION_MASK
+#define DETECTION_MASK
+
+#include <QVector>
+#include <QPolygonF>
+#include <QSize>
+
+class QTransform;
+
+namespace laser_painter {
+
+/// Pixels of an image where the laser dot is detected, compiled into
+/// per-row spans of active pixels.
+/// The mask is defined by polygons where the detection is enabled
+/// (included) and disabled (excluded, e.g. lamps and windows). Without
+/// included polygons, the entire image is included.
+class DetectionMask
+{
+public:
+    /// Active pixels [begin, end) of a row
+    struct Span {
+        int begin;
+        int end;
+    };
+
+    DetectionMask();
+
+    /// Compile the mask for an image of size @param size.
+    /// Polygons @param include and @param exclude are mapped to the image
+    /// coordinates by @param transform.
+    void compile(
+        const QVector<QPolygonF>& include,
+        const QVector<QPolygonF>& exclude,
+        const QTransform& transform,
+        const QSize& size
+    );
+
+    const QSize& size() const;
+    /// All pixels are active.
+    bool isFull() const;
+    /// Spans of the row @param row are [rowBegin(row), rowEnd(row)).
+    inline const Span* rowBegin(int row) const;
+    inline const Span* rowEnd(int row) const;
+
+private:
+    QSize _size;
+    bool _full;
+    QVector<Span> _spans;
+    // Spans of the row i are [_row_offsets[i], _row_offsets[i + 1])
+    QVector<int> _row_offsets;
+};
+
+const DetectionMask::Span* DetectionMask::rowBegin(int row) const
+{
+    return _spans.constData() + _row_offsets[row];
+}
+
+const DetectionMask::Span* DetectionMask::rowEnd(int row) const
+{
+    return _spans.constData() + _row_offsets[row + 1];
+}
+
+} // namespace laser_painter
+
+#endif // DETECTION_MASK
@@ -0,0 +1,75 @@
+#include "frame_throttle.h"
+
+#include <QImage>
+#include <QPointF>
+
+namespace laser_painter {
+
+FrameThrottle::FrameThrottle(QObject* parent)
+    : QObject(parent),
+    _idle_delay(0),
+    _idle_frame_period(1),
+    _idle(false),
+    _nb_skipped_frames(0),
+    _last_found_time(0),
+    _previous_frame_time(0)
+{
+    _clock.start();
+}
+
+void FrameThrottle::run(const QImage& frame)
+{
+    const qint64 frame_time = _clock.elapsed();
+    if(!_idle && _idle_delay > 0 && frame_time - _last_found_time > _idle_delay)
+        setIdle(true);
+
+    if(_idle && ++_nb_skipped_frames < _idle_frame_period)
+        return;
+    _nb_skipped_frames = 0;
+
+    // Detection runs synchronously (setLaserPosition() is called before
+    // the return).
+    emit frameAvailable(frame);
+    _previous_frame_time = frame_time;
+}
+
+void FrameThrottle::setLaserPosition(const QPointF& pos, bool found)
+{
+    Q_UNUSED(pos);
+
+    if(!found)
+        return;
+    _last_found_time = _clock.elapsed();
+    if(_idle) {
+        setIdle(false);
+        emit wokeUp(_last_found_time - _previous_frame_time);
+    }
+}
+
+void FrameThrottle::setIdleDelay(double delay)
+{
+    Q_ASSERT(delay >= 0);
+
+    _idle_delay = delay * 1000;
+    _last_found_time = _clock.elapsed();
+    if(_idle_delay == 0)
+        setIdle(false);
+}
+
+void FrameThrottle::setIdleFramePeriod(int period)
+{
+    Q_ASSERT(period > 0);
+
+    _idle_frame_period = period;
+}
+
+void FrameThrottle::setIdle(bool idle)
+{
+    if(idle == _idle)
+        return;
+    _idle = idle;
+    _nb_skipped_frames = 0;
+    emit idleChanged(_idle);
+}
+
+} // namespace laser_painter
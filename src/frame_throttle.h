@@ -0,0 +1,59 @@
+#ifndef FRAME_THROTTLE
+#define FRAME_THROTTLE
+
+#include <QObject>
+#include <QElapsedTimer>
+
+class QImage;
+class QPointF;
+
+namespace laser_painter {
+
+/// Reduce the rate of frames sent to the laser detector when no laser dot
+/// was found for a while (idle mode), and return to the full rate as soon
+/// as the dot is found.
+class FrameThrottle : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FrameThrottle(QObject* parent = 0);
+
+public slots:
+    /// Pass the frame @param frame, unless it's skipped in the idle mode.
+    void run(const QImage& frame);
+    /// Detection result for the last passed frame.
+    void setLaserPosition(const QPointF& pos, bool found);
+
+    /// Enter the idle mode after @param delay seconds without laser dot.
+    /// If zero, the idle mode is disabled.
+    void setIdleDelay(double delay);
+    /// Pass one frame of @param period in the idle mode.
+    void setIdleFramePeriod(int period);
+
+signals:
+    void frameAvailable(const QImage& frame) const;
+    void idleChanged(bool idle) const;
+    /// The laser dot was found in the idle mode. It was not found in the
+    /// previous passed frame, @param latency milliseconds before the end
+    /// of detection (upper bound of the wake-up latency).
+    void wokeUp(int latency) const;
+
+private:
+    void setIdle(bool idle);
+
+private:
+    qint64 _idle_delay; // milliseconds
+    int _idle_frame_period;
+    bool _idle;
+    int _nb_skipped_frames;
+    QElapsedTimer _clock;
+    // Time (_clock) of the last found laser dot and of the previous passed
+    // frame.
+    qint64 _last_found_time;
+    qint64 _previous_frame_time;
+};
+
+} // namespace laser_painter
+
+#endif // FRAME_THROTTLE
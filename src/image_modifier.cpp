@@ -1,32 +1,283 @@
 #include "image_modifier.h"
 
-#include <QImage>
+#include <algorithm>
+#include <cstring>
+
+#include <QTransform>
 
 namespace laser_painter {
 
+namespace {
+
+// Pixel formats read by the decimation passes. Brightness is the HSV value
+// (max of color channels). Pixels are written in the detector formats.
+
+struct RGB888Pixel {
+    typedef uchar Value;
+    static const int nb_channels = 3;
+    static const int size = 3;
+    static inline int brightness(const uchar* pixel) {
+        return qMax(pixel[0], qMax(pixel[1], pixel[2]));
+    }
+    static inline void read(const uchar* pixel, int* channels) {
+        channels[0] = pixel[0];
+        channels[1] = pixel[1];
+        channels[2] = pixel[2];
+    }
+    static inline void write(const uchar* pixel, Value* dst) {
+        dst[0] = pixel[0];
+        dst[1] = pixel[1];
+        dst[2] = pixel[2];
+    }
+};
+
+// Format_RGB32, Format_ARGB32 and Format_ARGB32_Premultiplied
+struct RGB32Pixel {
+    typedef uchar Value;
+    static const int nb_channels = 3;
+    static const int size = 4;
+    static inline int brightness(const uchar* pixel) {
+        QRgb rgb = *reinterpret_cast<const QRgb*>(pixel);
+        return qMax(qRed(rgb), qMax(qGreen(rgb), qBlue(rgb)));
+    }
+    static inline void read(const uchar* pixel, int* channels) {
+        QRgb rgb = *reinterpret_cast<const QRgb*>(pixel);
+        channels[0] = qRed(rgb);
+        channels[1] = qGreen(rgb);
+        channels[2] = qBlue(rgb);
+    }
+    static inline void write(const uchar* pixel, Value* dst) {
+        QRgb rgb = *reinterpret_cast<const QRgb*>(pixel);
+        dst[0] = qRed(rgb);
+        dst[1] = qGreen(rgb);
+        dst[2] = qBlue(rgb);
+    }
+};
+
+struct Gray8Pixel {
+    typedef uchar Value;
+    static const int nb_channels = 1;
+    static const int size = 1;
+    static inline int brightness(const uchar* pixel) {
+        return *pixel;
+    }
+    static inline void read(const uchar* pixel, int* channels) {
+        *channels = *pixel;
+    }
+    static inline void write(const uchar* pixel, Value* dst) {
+        *dst = *pixel;
+    }
+};
+
+struct Gray16Pixel {
+    typedef quint16 Value;
+    static const int nb_channels = 1;
+    static const int size = 2;
+    static inline int brightness(const uchar* pixel) {
+        return *reinterpret_cast<const quint16*>(pixel);
+    }
+    static inline void read(const uchar* pixel, int* channels) {
+        *channels = *reinterpret_cast<const quint16*>(pixel);
+    }
+    static inline void write(const uchar* pixel, Value* dst) {
+        *dst = *reinterpret_cast<const quint16*>(pixel);
+    }
+};
+
+// Clear the row @param row of @param dst if it has masked out pixels.
+inline void clearMaskedRow(QImage& dst, int row, const DetectionMask& mask)
+{
+    if(!mask.isFull())
+        std::memset(dst.scanLine(row), 0, dst.bytesPerLine());
+}
+
+// Write into the pixel i of @param dst the brightest pixel of the block
+// [x_bounds[i], x_bounds[i + 1]) x [y_bounds[j], y_bounds[j + 1]) of
+// @param roi of @param src.
+// Only pixels of the spans of @param mask are computed, the others are
+// zero.
+template<typename Pixel>
+void peakDecimate(const QImage& src, const QRect& roi, const QVector<int>& x_bounds, const QVector<int>& y_bounds, const DetectionMask& mask, QImage& dst)
+{
+    const int src_step = src.bytesPerLine();
+    for(int j = 0, height = dst.height(); j < height; ++j) {
+        clearMaskedRow(dst, j, mask);
+        typename Pixel::Value* dst_line = reinterpret_cast<typename Pixel::Value*>(dst.scanLine(j));
+        const uchar* block_line = src.constScanLine(roi.top() + y_bounds[j]) + roi.left() * Pixel::size;
+        const int block_height = y_bounds[j + 1] - y_bounds[j];
+        for(const DetectionMask::Span* span = mask.rowBegin(j), *spans_end = mask.rowEnd(j); span < spans_end; ++span)
+            for(int i = span->begin; i < span->end; ++i) {
+                const uchar* peak = block_line + x_bounds[i] * Pixel::size;
+                int peak_brightness = -1;
+                const uchar* line = block_line;
+                for(int y = 0; y < block_height; ++y, line += src_step) {
+                    const uchar* pixel = line + x_bounds[i] * Pixel::size;
+                    const uchar* end = line + x_bounds[i + 1] * Pixel::size;
+                    for(; pixel < end; pixel += Pixel::size) {
+                        int brightness = Pixel::brightness(pixel);
+                        if(brightness > peak_brightness) {
+                            peak_brightness = brightness;
+                            peak = pixel;
+                        }
+                    }
+                }
+                Pixel::write(peak, dst_line + i * Pixel::nb_channels);
+            }
+    }
+}
+
+// Write into the pixel i of @param dst the central pixel of the block
+// defined as in peakDecimate(). Without scale, this is a crop.
+template<typename Pixel>
+void nearestDecimate(const QImage& src, const QRect& roi, const QVector<int>& x_bounds, const QVector<int>& y_bounds, const DetectionMask& mask, QImage& dst)
+{
+    for(int j = 0, height = dst.height(); j < height; ++j) {
+        clearMaskedRow(dst, j, mask);
+        typename Pixel::Value* dst_line = reinterpret_cast<typename Pixel::Value*>(dst.scanLine(j));
+        const uchar* line = src.constScanLine(roi.top() + (y_bounds[j] + y_bounds[j + 1]) / 2) + roi.left() * Pixel::size;
+        for(const DetectionMask::Span* span = mask.rowBegin(j), *spans_end = mask.rowEnd(j); span < spans_end; ++span)
+            for(int i = span->begin; i < span->end; ++i)
+                Pixel::write(line + (x_bounds[i] + x_bounds[i + 1]) / 2 * Pixel::size, dst_line + i * Pixel::nb_channels);
+    }
+}
+
+// Write into the pixel i of @param dst the mean of the block defined as
+// in peakDecimate(). Blocks should have the same size (integer ratios).
+template<typename Pixel>
+void boxDecimate(const QImage& src, const QRect& roi, const QVector<int>& x_bounds, const QVector<int>& y_bounds, const DetectionMask& mask, QImage& dst)
+{
+    const int src_step = src.bytesPerLine();
+    const int block_width = x_bounds[1];
+    const int block_height = y_bounds[1];
+    const int block_area = block_width * block_height;
+    int channels[Pixel::nb_channels];
+    int sums[Pixel::nb_channels];
+    for(int j = 0, height = dst.height(); j < height; ++j) {
+        clearMaskedRow(dst, j, mask);
+        typename Pixel::Value* dst_line = reinterpret_cast<typename Pixel::Value*>(dst.scanLine(j));
+        const uchar* block_line = src.constScanLine(roi.top() + y_bounds[j]) + roi.left() * Pixel::size;
+        for(const DetectionMask::Span* span = mask.rowBegin(j), *spans_end = mask.rowEnd(j); span < spans_end; ++span)
+            for(int i = span->begin; i < span->end; ++i) {
+                std::fill(sums, sums + Pixel::nb_channels, 0);
+                const uchar* line = block_line + x_bounds[i] * Pixel::size;
+                for(int y = 0; y < block_height; ++y, line += src_step)
+                    for(const uchar* pixel = line, *end = line + block_width * Pixel::size; pixel < end; pixel += Pixel::size) {
+                        Pixel::read(pixel, channels);
+                        for(int c = 0; c < Pixel::nb_channels; ++c)
+                            sums[c] += channels[c];
+                    }
+                for(int c = 0; c < Pixel::nb_channels; ++c)
+                    dst_line[i * Pixel::nb_channels + c] = (sums[c] + block_area / 2) / block_area;
+            }
+    }
+}
+
+} // namespace
+
+ImageModifier::Axis::Axis()
+    : src_size(0),
+    dst_size(0)
+{}
+
+void ImageModifier::Axis::update(int new_src_size, int new_dst_size)
+{
+    Q_ASSERT(new_dst_size > 0 && new_dst_size <= new_src_size);
+
+    if(new_src_size == src_size && new_dst_size == dst_size)
+        return;
+    src_size = new_src_size;
+    dst_size = new_dst_size;
+
+    bounds.resize(dst_size + 1);
+    for(int i = 0; i <= dst_size; ++i)
+        bounds[i] = static_cast<qint64>(i) * src_size / dst_size;
+
+    // Area coefficients: scaled pixel i covers [i, i + 1) * ratio of the
+    // source, source pixels are weighted by their covered part.
+    firsts.resize(dst_size);
+    offsets.resize(dst_size + 1);
+    weights.clear();
+    const double ratio = static_cast<double>(src_size) / dst_size;
+    for(int i = 0; i < dst_size; ++i) {
+        const double begin = i * ratio;
+        const double end = qMin((i + 1) * ratio, static_cast<double>(src_size));
+        firsts[i] = static_cast<int>(begin);
+        offsets[i] = weights.size();
+        for(int k = firsts[i]; k < end; ++k)
+            weights.append((qMin(k + 1., end) - qMax(static_cast<double>(k), begin)) / ratio);
+    }
+    offsets[dst_size] = weights.size();
+}
+
+bool ImageModifier::Axis::isIntegerRatio() const
+{
+    return src_size % dst_size == 0;
+}
+
 ImageModifier::ImageModifier(QObject* parent)
     : QObject(parent),
     _roi(),
-    _scale(1.)
+    _roi_frame_size(),
+    _scale(1.),
+    _frame_scale(1.),
+    _scale_mode(PeakScale)
 {}
 
-void ImageModifier::run(const QImage& image) const
+void ImageModifier::run(const QImage& image)
 {
-    if(image.isNull() || !QRect(QPoint(), image.size()).contains(_roi))
+    if(image.isNull())
+        return;
+
+    QRect roi = _roi.isEmpty() ? QRect(QPoint(), image.size()) : _roi;
+    if(!_roi.isEmpty() && !_roi_frame_size.isEmpty() && image.size() != _roi_frame_size) {
+        // Frame size changed before the roi was updated
+        const qreal scale_x = static_cast<qreal>(image.width()) / _roi_frame_size.width();
+        const qreal scale_y = static_cast<qreal>(image.height()) / _roi_frame_size.height();
+        roi = QRect(
+            QPoint(qRound(_roi.left() * scale_x), qRound(_roi.top() * scale_y)),
+            QPoint(qRound((_roi.right() + 1) * scale_x) - 1, qRound((_roi.bottom() + 1) * scale_y) - 1)
+        ) & QRect(QPoint(), image.size());
+    }
+    if(roi.isEmpty() || !QRect(QPoint(), image.size()).contains(roi))
         return;
+    // Remaining scale of the already scaled input image
+    qreal scale = _scale / _frame_scale;
 
-    QImage result = (_roi.isEmpty() || image.size() == _roi.size()) ? image : image.copy(_roi);
-    if(_scale != 1.)
-        result = result.scaled(result.width() * _scale, result.height() * _scale);
+    QImage result;
+    if(scale < 1.)
+        result = scaled(image, roi, QSize(roi.width() * scale, roi.height() * scale), _scale_mode);
+    else if(
+        roi.size() == image.size() && !hasMask() && (
+            image.format() == QImage::Format_RGB888 ||
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+            image.format() == QImage::Format_Grayscale16 ||
+#endif
+            image.format() == QImage::Format_Grayscale8
+        )
+    )
+        // Nothing to do
+        result = image;
+    else
+        // Crop and/or convert only
+        result = scaled(image, roi, roi.size(), NearestScale);
 
-    if(!result.isNull())
+    if(result.isNull())
         // Small images can become null after scale.
-        emit imageAvailable(result);
+        return;
+
+    if(image.size() != _geometry_frame_size || roi != _geometry_roi || result.size() != _geometry_size) {
+        _geometry_frame_size = image.size();
+        _geometry_roi = roi;
+        _geometry_size = result.size();
+        emit geometryChanged(_geometry_frame_size, _geometry_roi, _geometry_size);
+    }
+    emit imageAvailable(result);
 }
 
-void ImageModifier::setROI(const QRect& roi)
+void ImageModifier::setROI(const QRect& roi, const QSize& frame_size)
 {
     _roi = roi;
+    _roi_frame_size = frame_size;
 }
 
 void ImageModifier::setScale(qreal scale)
@@ -34,4 +285,162 @@ void ImageModifier::setScale(qreal scale)
     _scale = scale;
 }
 
-} // namespace laser_painter
\ No newline at end of file
+void ImageModifier::setFrameScale(qreal scale)
+{
+    Q_ASSERT(scale > 0);
+    _frame_scale = scale;
+}
+
+void ImageModifier::setScaleMode(ScaleMode mode)
+{
+    _scale_mode = mode;
+}
+
+void ImageModifier::setMask(const QVector<QPolygonF>& include, const QVector<QPolygonF>& exclude)
+{
+    _mask_include = include;
+    _mask_exclude = exclude;
+    // Recompile with the next frame
+    _mask_frame_size = QSize();
+    if(!hasMask())
+        // Unmasked frames may skip the compilation.
+        emit maskAvailable(DetectionMask());
+}
+
+bool ImageModifier::hasMask() const
+{
+    return !_mask_include.isEmpty() || !_mask_exclude.isEmpty();
+}
+
+void ImageModifier::updateMask(const QSize& frame_size, const QRect& roi, const QSize& size)
+{
+    if(frame_size == _mask_frame_size && roi == _mask_roi && size == _mask.size())
+        return;
+    _mask_frame_size = frame_size;
+    _mask_roi = roi;
+
+    // From normalized frame coordinates to the scaled roi coordinates
+    QTransform transform =
+        QTransform::fromScale(frame_size.width(), frame_size.height()) *
+        QTransform::fromTranslate(-roi.left(), -roi.top()) *
+        QTransform::fromScale(
+            static_cast<qreal>(size.width()) / roi.width(),
+            static_cast<qreal>(size.height()) / roi.height()
+        );
+    _mask.compile(_mask_include, _mask_exclude, transform, size);
+    emit maskAvailable(_mask);
+}
+
+QImage ImageModifier::scaled(const QImage& image, const QRect& roi, const QSize& size, ScaleMode mode)
+{
+    if(size.isEmpty())
+        return QImage();
+
+    _x_axis.update(roi.width(), size.width());
+    _y_axis.update(roi.height(), size.height());
+    updateMask(image.size(), roi, size);
+
+    switch(image.format()) {
+    case QImage::Format_RGB888:
+    {
+        QImage& result = buffer(size, QImage::Format_RGB888);
+        decimate<RGB888Pixel>(image, roi, mode, result);
+        return result;
+    }
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+    {
+        QImage& result = buffer(size, QImage::Format_RGB888);
+        decimate<RGB32Pixel>(image, roi, mode, result);
+        return result;
+    }
+    case QImage::Format_Grayscale8:
+    {
+        QImage& result = buffer(size, QImage::Format_Grayscale8);
+        decimate<Gray8Pixel>(image, roi, mode, result);
+        return result;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    case QImage::Format_Grayscale16:
+    {
+        QImage& result = buffer(size, QImage::Format_Grayscale16);
+        decimate<Gray16Pixel>(image, roi, mode, result);
+        return result;
+    }
+#endif
+    default:
+    {
+        // Other formats are converted first
+        QImage rgb_roi = image.copy(roi).convertToFormat(QImage::Format_RGB888);
+        if(rgb_roi.isNull())
+            return QImage();
+        QImage& result = buffer(size, QImage::Format_RGB888);
+        decimate<RGB888Pixel>(rgb_roi, rgb_roi.rect(), mode, result);
+        return result;
+    }
+    }
+}
+
+template<typename Pixel>
+void ImageModifier::decimate(const QImage& src, const QRect& roi, ScaleMode mode, QImage& dst)
+{
+    if(mode == PeakScale) {
+        peakDecimate<Pixel>(src, roi, _x_axis.bounds, _y_axis.bounds, _mask, dst);
+        return;
+    }
+    if(mode == NearestScale) {
+        nearestDecimate<Pixel>(src, roi, _x_axis.bounds, _y_axis.bounds, _mask, dst);
+        return;
+    }
+    if(_x_axis.isIntegerRatio() && _y_axis.isIntegerRatio()) {
+        boxDecimate<Pixel>(src, roi, _x_axis.bounds, _y_axis.bounds, _mask, dst);
+        return;
+    }
+
+    // Separable area resampling: each source row is resampled horizontally,
+    // then accumulated into the scaled rows it covers.
+    const int row_size = dst.width() * Pixel::nb_channels;
+    _resampled_row.resize(row_size);
+    _accumulated_row.resize(row_size);
+    int channels[Pixel::nb_channels];
+    for(int j = 0, height = dst.height(); j < height; ++j) {
+        const DetectionMask::Span* spans_begin = _mask.rowBegin(j);
+        const DetectionMask::Span* spans_end = _mask.rowEnd(j);
+        _accumulated_row.fill(0.f);
+        for(int l = _y_axis.offsets[j], y = _y_axis.firsts[j]; l < _y_axis.offsets[j + 1]; ++l, ++y) {
+            // Horizontal pass
+            const uchar* line = src.constScanLine(roi.top() + y) + roi.left() * Pixel::size;
+            for(const DetectionMask::Span* span = spans_begin; span < spans_end; ++span)
+                for(int i = span->begin; i < span->end; ++i) {
+                    float* resampled = _resampled_row.data() + i * Pixel::nb_channels;
+                    std::fill(resampled, resampled + Pixel::nb_channels, 0.f);
+                    const uchar* pixel = line + _x_axis.firsts[i] * Pixel::size;
+                    for(int k = _x_axis.offsets[i]; k < _x_axis.offsets[i + 1]; ++k, pixel += Pixel::size) {
+                        Pixel::read(pixel, channels);
+                        for(int c = 0; c < Pixel::nb_channels; ++c)
+                            resampled[c] += _x_axis.weights[k] * channels[c];
+                    }
+                }
+            // Vertical pass (pixels out of spans are never written)
+            const float weight = _y_axis.weights[l];
+            for(int k = 0; k < row_size; ++k)
+                _accumulated_row[k] += weight * _resampled_row[k];
+        }
+        clearMaskedRow(dst, j, _mask);
+        typename Pixel::Value* dst_line = reinterpret_cast<typename Pixel::Value*>(dst.scanLine(j));
+        for(const DetectionMask::Span* span = spans_begin; span < spans_end; ++span)
+            for(int k = span->begin * Pixel::nb_channels; k < span->end * Pixel::nb_channels; ++k)
+                dst_line[k] = static_cast<typename Pixel::Value>(_accumulated_row[k] + 0.5f);
+    }
+}
+
+QImage& ImageModifier::buffer(const QSize& size, QImage::Format format)
+{
+    // The detector doesn't keep images, the buffer can usually be reused.
+    if(_buffer.size() != size || _buffer.format() != format || !_buffer.isDetached())
+        _buffer = QImage(size, format);
+    return _buffer;
+}
+
+} // namespace laser_painter
@@ -3,34 +3,129 @@
 
 #include <QObject>
 #include <QRect>
+#include <QVector>
+#include <QImage>
+#include <QPolygonF>
 
-class QImage;
+#include "detection_mask.h"
 
 namespace laser_painter {
 
 /// Scale and crop (by region of interest) of the input image.
+/// Crop, scale and conversion to the detector format (RGB888, or
+/// Grayscale8/Grayscale16 for grayscale images) are done in a single pass
+/// into a reused buffer.
 class ImageModifier : public QObject
 {
     Q_OBJECT
 
 public:
+    enum ScaleMode {
+        /// Nearest pixel, small laser dots can vanish between sampled pixels.
+        NearestScale,
+        /// Brightest pixel of each block (with its color), small laser dots
+        /// are kept at high downscales.
+        PeakScale,
+        /// Mean of pixels covered by each scaled pixel.
+        AreaScale
+    };
+
     explicit ImageModifier(QObject* parent = 0);
 
 public slots:
-    void run(const QImage& image) const;
-    /// Set region of interest (in a coordinate system of the input image).
-    void setROI(const QRect& roi);
+    void run(const QImage& image);
+    /// Set region of interest @param roi (in a coordinate system of the
+    /// input image of size @param frame_size). It is rescaled for frames of
+    /// another size (the grabber decode scale changed).
+    void setROI(const QRect& roi, const QSize& frame_size);
     void setScale(qreal scale);
+    /// Set the scale @param scale of input images relatively to the camera
+    /// resolution (when the grabber already downscaled them).
+    void setFrameScale(qreal scale);
+    void setScaleMode(ScaleMode mode);
+    /// Set the detection mask polygons @param include and @param exclude
+    /// (in the normalized coordinates of the input image, [0, 1]^2).
+    /// Masked out pixels are not computed by the decimation and are black.
+    void setMask(const QVector<QPolygonF>& include, const QVector<QPolygonF>& exclude);
 
 signals:
     /// Modified image available
     void imageAvailable(const QImage& image) const;
+    /// Mask @param mask of the next modified images (emitted when changed).
+    void maskAvailable(const DetectionMask& mask) const;
+    /// The next modified images of size @param size are the region
+    /// @param roi of frames of size @param frame_size (emitted when
+    /// changed).
+    void geometryChanged(const QSize& frame_size, const QRect& roi, const QSize& size) const;
+
+private:
+    // Source pixels decimated into each scaled pixel along an axis.
+    struct Axis {
+        Axis();
+        // Update for the decimation of @param src_size pixels into
+        // @param dst_size pixels (only if changed).
+        void update(int src_size, int dst_size);
+        // Integer ratio between sizes
+        bool isIntegerRatio() const;
+
+        int src_size;
+        int dst_size;
+        // Source pixels [bounds[i], bounds[i + 1]) are decimated into the
+        // pixel i. Blocks sizes differ by at most one pixel for non-integer
+        // ratios.
+        QVector<int> bounds;
+        // Area resampling coefficients: pixel i is the sum of source pixels
+        // from firsts[i] weighted by weights[offsets[i]..offsets[i + 1]).
+        QVector<int> firsts;
+        QVector<int> offsets;
+        QVector<float> weights;
+    };
+
+private:
+    // Crop @param roi of @param image and decimate it to @param size with
+    // @param mode in a single pass.
+    // The result is a RGB888 image (Grayscale8 or Grayscale16 for
+    // grayscale input images) written into _buffer.
+    QImage scaled(const QImage& image, const QRect& roi, const QSize& size, ScaleMode mode);
+    // Decimate @param roi of @param src (of the pixel type Pixel) into
+    // @param dst with @param mode.
+    template<typename Pixel>
+    void decimate(const QImage& src, const QRect& roi, ScaleMode mode, QImage& dst);
+    // Return the output buffer of size @param size and format @param format,
+    // reuse the previous one if nobody else holds it.
+    QImage& buffer(const QSize& size, QImage::Format format);
+    bool hasMask() const;
+    // Compile the mask for the @param roi of frames of size
+    // @param frame_size scaled to @param size (only if changed).
+    void updateMask(const QSize& frame_size, const QRect& roi, const QSize& size);
 
 private:
     QRect _roi;
+    QSize _roi_frame_size;
     qreal _scale;
+    qreal _frame_scale;
+    ScaleMode _scale_mode;
+
+    QVector<QPolygonF> _mask_include;
+    QVector<QPolygonF> _mask_exclude;
+    // Mask compiled for the scaled roi
+    DetectionMask _mask;
+    QSize _mask_frame_size;
+    QRect _mask_roi;
+
+    // Geometry of the last modified image
+    QSize _geometry_frame_size;
+    QRect _geometry_roi;
+    QSize _geometry_size;
+
+    Axis _x_axis;
+    Axis _y_axis;
+    QImage _buffer;
+    // Rows of the area resampling
+    QVector<float> _resampled_row;
+    QVector<float> _accumulated_row;
 };
 
 } // namespace laser_painter
 
-#endif // IMAGE_MODIFIER
\ No newline at end of file
+#endif // IMAGE_MODIFIER
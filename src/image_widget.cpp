@@ -5,7 +5,9 @@
 namespace laser_painter {
 
 ImageWidget::ImageWidget(QWidget* parent, Qt::WindowFlags f)
-    : QWidget(parent, f)
+    : QWidget(parent, f),
+    _flip_x(false),
+    _flip_y(false)
 {
     QPalette palette = this->palette();
     palette.setColor(QPalette::Background, Qt::black);
@@ -21,6 +23,13 @@ void ImageWidget::setImage(const QImage& image)
     repaint();
 }
 
+void ImageWidget::setFlip(bool flip_x, bool flip_y)
+{
+    _flip_x = flip_x;
+    _flip_y = flip_y;
+    update();
+}
+
 void ImageWidget::paintEvent(QPaintEvent* event)
 {
     Q_UNUSED(event);
@@ -29,6 +38,14 @@ void ImageWidget::paintEvent(QPaintEvent* event)
         return;
 
     QPainter painter(this);
+    if(_flip_x || _flip_y)
+        // Mirror the image rect in place
+        painter.setTransform(QTransform(
+            _flip_x ? -1 : 1, 0,
+            0, _flip_y ? -1 : 1,
+            _flip_x ? 2 * _image_origin.x() + _image.width() : 0,
+            _flip_y ? 2 * _image_origin.y() + _image.height() : 0
+        ));
     painter.drawImage(_image_origin, _image);
 }
 
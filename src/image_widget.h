@@ -18,6 +18,9 @@ public:
 public slots:
     /// Repaint with a new frame @param image.
     void setImage(const QImage& image);
+    /// Show the image flipped horizontally if @param flip_x and vertically
+    /// if @param flip_y.
+    void setFlip(bool flip_x, bool flip_y);
 
 protected:
     void paintEvent(QPaintEvent* event);
@@ -26,6 +29,9 @@ protected:
     // Current frame to paint.
     QImage _image;
     QPoint _image_origin;
+    // The image is mirrored only when painted.
+    bool _flip_x;
+    bool _flip_y;
 };
 
 } // namespace laser_painter
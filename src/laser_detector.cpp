@@ -1,8 +1,11 @@
 #include "laser_detector.h"
 
 #include <vector>
+#include <algorithm>
+#include <cmath>
 
 #include <QImage>
+#include <QPoint>
 #include <QPointF>
 #include <QSize>
 
@@ -11,6 +14,170 @@
 
 namespace laser_painter {
 
+namespace {
+
+// Bounds of the blocks of pixels of a map of @param map_size pixels
+// covering the @param size pixels the region [@param roi_begin,
+// @param roi_begin + @param roi_size) of frames of @param frame_size pixels
+// is scaled to (along an axis, the map covers entire frames).
+QVector<int> hotspotMapBounds(int frame_size, int roi_begin, int roi_size, int size, int map_size)
+{
+    QVector<int> bounds(size + 1);
+    const double scale = static_cast<double>(map_size) / frame_size;
+    for(int i = 0; i <= size; ++i)
+        bounds[i] = qBound(0, static_cast<int>((roi_begin + static_cast<double>(i) * roi_size / size) * scale), map_size);
+    return bounds;
+}
+
+// End of the block @param i of @param bounds: blocks have at least one
+// pixel (maps of lower resolutions than input images).
+inline int blockEnd(const QVector<int>& bounds, int i, int map_size)
+{
+    return qMax(bounds[i + 1], qMin(bounds[i] + 1, map_size));
+}
+
+// The block (@param j, @param i) of @param map (Format_Grayscale8) has
+// nonzero pixels.
+bool hotspotMapBlock(const QImage& map, const QVector<int>& x_bounds, const QVector<int>& y_bounds, int j, int i)
+{
+    for(int y = y_bounds[i], y_end = blockEnd(y_bounds, i, map.height()); y < y_end; ++y) {
+        const uchar* line = map.constScanLine(y);
+        for(int x = x_bounds[j], x_end = blockEnd(x_bounds, j, map.width()); x < x_end; ++x)
+            if(line[x])
+                return true;
+    }
+    return false;
+}
+
+// Accumulate maxima of values of the image @param image (of
+// @param nb_channels values of type T per pixel) by tiles of
+// @param tile_size pixels, and sums by blocks of @param block_size pixels
+// (a decimated image). @param tile_size is a multiple of @param block_size.
+template<typename T>
+void tileStatistics(const QImage& image, int nb_channels, int tile_size, int nb_tile_cols, int block_size, int nb_block_cols, quint16* maxima, quint32* sums)
+{
+    const int blocks_per_tile = tile_size / block_size;
+    for(int i = 0; i < image.height(); ++i) {
+        const T* line = reinterpret_cast<const T*>(image.constScanLine(i));
+        const int tile_row_offset = (i / tile_size) * nb_tile_cols;
+        const int block_row_offset = (i / block_size) * nb_block_cols;
+        for(int block_col = 0; block_col < nb_block_cols; ++block_col) {
+            const T* value = line + block_col * block_size * nb_channels;
+            const T* end = line + qMin((block_col + 1) * block_size, image.width()) * nb_channels;
+            T max = 0;
+            quint32 sum = 0;
+            for(; value < end; ++value) {
+                max = qMax(max, *value);
+                sum += *value;
+            }
+            quint16& tile_max = maxima[tile_row_offset + block_col / blocks_per_tile];
+            tile_max = qMax<quint16>(tile_max, max);
+            sums[block_row_offset + block_col] += sum;
+        }
+    }
+}
+
+// Threshold values of @param value (of type T) by @param threshold into
+// the binary image @param binary (255 if value >= threshold, 0 otherwise)
+// in one pass with the search of the maximum of values where @param mask
+// is nonzero (all values if @param mask is null).
+template<typename T>
+int thresholdAndMax(const cv::Mat& value, int threshold, const uchar* mask, cv::Mat& binary)
+{
+    binary.create(value.rows, value.cols, CV_8UC1);
+    T max = 0;
+    for(int i = 0; i < value.rows; ++i) {
+        const T* value_row = value.ptr<T>(i);
+        uchar* binary_row = binary.ptr<uchar>(i);
+        if(mask) {
+            const uchar* mask_row = mask + i * value.cols;
+            for(int j = 0; j < value.cols; ++j) {
+                const T v = value_row[j];
+                binary_row[j] = v >= threshold ? 255 : 0;
+                if(mask_row[j] && v > max)
+                    max = v;
+            }
+        } else
+            for(int j = 0; j < value.cols; ++j) {
+                const T v = value_row[j];
+                binary_row[j] = v >= threshold ? 255 : 0;
+                max = qMax(max, v);
+            }
+    }
+    return max;
+}
+
+// Hue of the RGB color @param r, @param g, @param b as computed by
+// cv::cvtColor(cv::COLOR_RGB2HSV) for 8-bit images, in [0, 180).
+int hue(int r, int g, int b)
+{
+    const int v = qMax(r, qMax(g, b));
+    const int diff = v - qMin(r, qMin(g, b));
+    if(diff == 0)
+        return 0;
+    double h;
+    if(v == r)
+        h = 60. * (g - b) / diff;
+    else if(v == g)
+        h = 120. + 60. * (b - r) / diff;
+    else
+        h = 240. + 60. * (r - g) / diff;
+    if(h < 0.)
+        h += 360.;
+    const int result = qRound(h / 2.);
+    return result >= 180 ? result - 180 : result;
+}
+
+// Accumulate weights of pixels of the blob @param mask (nonzero) into
+// @param column_weights and @param row_weights. Weights are values of
+// @param value (of type T) above @param threshold - 1.
+template<typename T>
+void blobWeights(const cv::Mat& value, const cv::Mat& mask, int threshold, std::vector<double>& column_weights, std::vector<double>& row_weights)
+{
+    for(int i = 0; i < value.rows; ++i) {
+        const T* value_row = value.ptr<T>(i);
+        const uchar* mask_row = mask.ptr<uchar>(i);
+        for(int j = 0; j < value.cols; ++j) {
+            if(mask_row[j] == 0 || value_row[j] < threshold)
+                continue;
+            const double weight = value_row[j] - threshold + 1;
+            column_weights[j] += weight;
+            row_weights[i] += weight;
+        }
+    }
+}
+
+// Mean of indices of @param weights, weighted. Weights sum to
+// @param total > 0.
+double weightedMean(const std::vector<double>& weights, double total)
+{
+    double sum = 0.;
+    for(size_t i = 0; i < weights.size(); ++i)
+        sum += i * weights[i];
+    return sum / total;
+}
+
+// Sub-pixel position of the peak of @param weights, by a Gaussian fitted to
+// the highest weight and its neighbours, or @param fallback if the fit is
+// not defined (peak on the border, plateau).
+double gaussianPeak(const std::vector<double>& weights, double fallback)
+{
+    const int peak = std::max_element(weights.begin(), weights.end()) - weights.begin();
+    if(peak == 0 || peak + 1 >= static_cast<int>(weights.size()) || weights[peak - 1] <= 0. || weights[peak + 1] <= 0.)
+        return fallback;
+    const double left = std::log(weights[peak - 1]);
+    const double center = std::log(weights[peak]);
+    const double right = std::log(weights[peak + 1]);
+    const double curvature = left - 2. * center + right;
+    if(curvature >= 0.)
+        return fallback;
+    return peak + (left - right) / (2. * curvature);
+}
+
+} // namespace
+
+const double LaserDetector::_blob_verdict_area_tolerance = 0.1;
+
 /// inspired by "LASER SPOT DETECTION" of Matej MESKO and Stefan TOTH, 2013
 LaserDetector::LaserDetector
 (
@@ -27,11 +194,27 @@ LaserDetector::LaserDetector
     uchar hue_min,
     uchar hue_max,
     double blob_crown_valid_pixels_part_min,
+    bool luminance_only,
 
     bool emit_filtered_images
 ) :
-    QObject(parent)
+    QObject(parent),
+    _published_parameters(0),
+    _nb_hotspots(0),
+    _frame_index(0),
+    _tiles_valid(false),
+    _tiles_brightness_max(0),
+    _last_threshold(-1),
+    _detect(0),
+    _detect_format(QImage::Format_Invalid),
+    _has_last_position(false),
+    _last_position_found(false)
 {
+    _next_parameters.blob_closing_enabled = true;
+    _next_parameters.center_mode = ContourCenter;
+    _next_parameters.hotspot_learning = false;
+    _next_parameters.skip_static_frames = true;
+    _next_parameters.streaming_threshold = true;
     setHighestBrightnessMin(highest_brightness_min);
     setRelativeBrightnessMin(relative_brightness_min);
     setBlobClosingSize(blob_closing_size);
@@ -40,54 +223,173 @@ LaserDetector::LaserDetector
     setBlobPerimeterRange(blob_perimeter_min, blob_perimeter_max);
     setHueRange(hue_min, hue_max);
     setBlobCrownValidPixelsPartMin(blob_crown_valid_pixels_part_min);
+    setLuminanceOnly(luminance_only);
 
     setEmitFilteredImages(emit_filtered_images);
+    updateParameters();
+}
+
+LaserDetector::~LaserDetector()
+{
+    delete _published_parameters.loadAcquire();
+}
+
+void LaserDetector::run(const QImage& image)
+{
+    updateParameters();
+
+    // Frames without changes give the same result. Frames with a laser dot
+    // are always processed: small dot moves can be below the tolerances.
+    // Hotspots are learned on static frames too.
+    const bool changed = updateTiles(image);
+    if(!changed && _parameters->skip_static_frames && _has_last_position && !_last_position_found &&
+        !_parameters->emit_filtered_images && !_parameters->hotspot_learning) {
+        emit laserPosition(_last_position, _last_position_found);
+        return;
+    }
+    if(!_detect || image.format() != _detect_format)
+        selectDetect(image.format());
+    (this->*_detect)(image);
+}
+
+template<typename T>
+QPointF LaserDetector::blobCenter(const cv::Mat& value, const cv::Mat& blob, const QPoint& offset, const cv::Moments& moments, int threshold) const
+{
+    if(_parameters->center_mode == ContourCenter)
+        return center(moments);
+
+    // Projections of the blob brightness on columns and rows
+    std::vector<double> column_weights(value.cols, 0.);
+    std::vector<double> row_weights(value.rows, 0.);
+    blobWeights<T>(value, blob, threshold, column_weights, row_weights);
+    double total = 0.;
+    for(size_t i = 0; i < row_weights.size(); ++i)
+        total += row_weights[i];
+    if(total <= 0.)
+        return center(moments);
+
+    double x = weightedMean(column_weights, total);
+    double y = weightedMean(row_weights, total);
+    if(_parameters->center_mode == GaussianCenter) {
+        x = gaussianPeak(column_weights, x);
+        y = gaussianPeak(row_weights, y);
+    }
+    return QPointF(offset.x() + x, offset.y() + y);
 }
 
-void LaserDetector::run(const QImage& image) const
+template<typename T, bool CrownCheck, bool Closing, bool EmitFilteredImages>
+void LaserDetector::detect(const QImage& image)
 {
-    // Convert to HSV
-    cv::Mat hsv_mat;
-    cv::cvtColor(QImage2cvMat(image), hsv_mat, cv::COLOR_RGB2HSV);
+    // Verdicts of the previous frame are matched, the ones of this frame
+    // are collected. Frames ending early leave no verdicts to the next one.
+    _previous_blob_verdicts.swap(_blob_verdicts);
+    _blob_verdicts.clear();
 
-    if(hsv_mat.empty()) {
-        emit laserPosition(QPointF(), false);
+    // Value (brightness) channel of type T, 8-bit or 16-bit (grayscale
+    // input). Hues of crown pixels are looked up from the RGB image.
+    cv::Mat rgb_mat;
+    cv::Mat value;
+    cv::Mat* v = &value;
+    if(isGrayscale(image))
+        *v = QImage2cvGrayMat(image);
+    else {
+        rgb_mat = QImage2cvMat(image);
+        if(rgb_mat.empty()) {
+            setLaserPosition(QPointF(), false);
+            return;
+        }
+        // HSV value: max(R, G, B)
+        cv::Mat rgb[3];
+        cv::split(rgb_mat, rgb);
+        cv::max(rgb[0], rgb[1], *v);
+        cv::max(*v, rgb[2], *v);
+    }
+
+    if(v->empty()) {
+        setLaserPosition(QPointF(), false);
         return;
     }
 
-    // Split input into [hue, saturation, value] channels
-    cv::Mat hsv[3];
-    cv::split(hsv_mat, hsv);
-    cv::Mat* h = hsv;
-//     cv::Mat* s = hsv + 1;
-    cv::Mat* v = hsv + 2;
+    if(updateHotspotGeometry(QSize(v->cols, v->rows)))
+        _previous_blob_verdicts.clear();
+    cv::Mat hotspot_map(v->rows, v->cols, CV_8UC1, _hotspot_map.data());
 
-    // Dynamic value (brightness) threshold
+    // Dynamic value (brightness) threshold, hotspots aside
+    // Brightness thresholds are set for 8-bit values.
+    const double brightness_scale = sizeof(T) == 2 ? 257. : 1.;
     double min_brightness, max_brightness;
-    cv::minMaxLoc(*v, &min_brightness, &max_brightness);
-    if(max_brightness < _highest_brightness_min) {
+    cv::Mat v_bin;
+    // Threshold of the previous frame used for v_bin, if any
+    bool thresholded = false;
+    if(_nb_hotspots == 0 && _tiles_valid)
+        // Already known from the change detection: the value is the max of
+        // color channels.
+        max_brightness = _tiles_brightness_max;
+    else if(_parameters->streaming_threshold && _last_threshold >= 0) {
+        // Threshold by the threshold of the previous frame in the pass
+        // searching the maximum, checked below.
+        const uchar* mask = _nb_hotspots > 0 ?
+            reinterpret_cast<const uchar*>(_hotspot_free_map.constData()) : 0;
+        max_brightness = thresholdAndMax<T>(*v, _last_threshold, mask, v_bin);
+        thresholded = true;
+    } else if(_nb_hotspots > 0)
+        cv::minMaxLoc(*v, &min_brightness, &max_brightness, 0, 0,
+            cv::Mat(v->rows, v->cols, CV_8UC1, _hotspot_free_map.data()));
+    else
+        cv::minMaxLoc(*v, &min_brightness, &max_brightness);
+    const int DV_thresh = static_cast<int>(std::round(_parameters->relative_brightness_min * max_brightness));
+    const int last_threshold = _last_threshold;
+    _last_threshold = DV_thresh;
+    if(max_brightness < _parameters->highest_brightness_min * brightness_scale) {
         // Spots aren't bright enough
-        emit laserPosition(QPointF(), false);
-        if(_emit_filtered_images)
-            emit blobsAvailable(cvMat2QImage(cv::Mat(hsv_mat.size(), CV_8UC1, cv::Scalar(0))));
+        setLaserPosition(QPointF(), false);
+        if(EmitFilteredImages)
+            emit blobsAvailable(cvMat2QImage(cv::Mat(v->size(), CV_8UC1, cv::Scalar(0))));
         return;
     }
-    uchar DV_thresh = std::round(_relative_brightness_min * max_brightness);
-    // Filter by the dynamic value threshold
-    cv::Mat v_bin = *v >= DV_thresh;
-
-    // Morphological closing of the value channel
-    if(_blob_closing_size > 0)
-        cv::morphologyEx(
-            v_bin,
-            v_bin,
-            cv::MORPH_CLOSE,
-            cv::getStructuringElement(cv::MORPH_ELLIPSE,
-                cv::Size(_blob_closing_size, _blob_closing_size))
-        );
+    // Filter by the dynamic value threshold, again if the maximum changed
+    // the threshold since the previous frame.
+    if(!thresholded || DV_thresh != last_threshold)
+        v_bin = *v >= DV_thresh;
+
+    if(_parameters->hotspot_learning && ++_frame_index % _hotspot_learning_period == 0)
+        learnHotspots(v_bin);
+
+    // Morphological closing of the value channel, on bits
+    if(Closing) {
+        _closing_bits.fromBytes(v_bin.data, v_bin.cols, v_bin.rows, v_bin.step);
+        // Closed blobs stay within the kernel reach of the blobs, and blobs
+        // farther than 3 reaches apart don't interact: close windows of
+        // blob groups only. The windows are exact in 1 reach of the groups
+        // (pixels of the dilated groups are within 2 reaches).
+        const int reach = BitMask::reach(_parameters->closing_kernel);
+        QVector<QRect> groups;
+        if(_closing_bits.boundingRects(3 * reach, _closing_nb_groups_max, groups)) {
+            const QRect frame(0, 0, v_bin.cols, v_bin.rows);
+            for(int i = 0, size = groups.size(); i < size; ++i) {
+                const QRect window = groups[i].adjusted(-2 * reach, -2 * reach, 2 * reach, 2 * reach) & frame;
+                const QRect closed_rect = groups[i].adjusted(-reach, -reach, reach, reach) & frame;
+                cv::Mat window_bin = v_bin(cv::Rect(window.x(), window.y(), window.width(), window.height()));
+                _closing_bits.fromBytes(window_bin.data, window_bin.cols, window_bin.rows, window_bin.step);
+                _closing_bits.close(_parameters->closing_kernel, _closing_buffer);
+                cv::Mat closed(window_bin.rows, window_bin.cols, CV_8UC1);
+                _closing_bits.toBytes(closed.data, closed.step);
+                closed(cv::Rect(closed_rect.x() - window.x(), closed_rect.y() - window.y(), closed_rect.width(), closed_rect.height()))
+                    .copyTo(v_bin(cv::Rect(closed_rect.x(), closed_rect.y(), closed_rect.width(), closed_rect.height())));
+            }
+        } else {
+            // Too many blobs, close the entire frame
+            _closing_bits.close(_parameters->closing_kernel, _closing_buffer);
+            _closing_bits.toBytes(v_bin.data, v_bin.step);
+        }
+    }
+
+    // Suppress hotspots
+    if(_nb_hotspots > 0)
+        v_bin.setTo(0, hotspot_map);
 
     // Send thresolded blobs image
-    if(_emit_filtered_images)
+    if(EmitFilteredImages)
         emit blobsAvailable(cvMat2QImage(v_bin));
 
     // Detect blobs
@@ -95,76 +397,102 @@ void LaserDetector::run(const QImage& image) const
     cv::findContours(v_bin, contours, CV_RETR_LIST, CV_CHAIN_APPROX_NONE);
 
     // Break if there's too much blobs.
-    if(contours.size() > _nb_blobs_max) {
-        emit laserPosition(QPointF(), false);
+    if(contours.size() > _parameters->nb_blobs_max) {
+        setLaserPosition(QPointF(), false);
         return;
     }
 
+    // Filtered images need the full crown test.
+    const bool reuse_verdicts = CrownCheck && !EmitFilteredImages;
+
     // Process blobs
-    const cv::Mat cross = cv::getStructuringElement(cv::MORPH_CROSS, cv::Size(3, 3));
     for(size_t i = 0, size = contours.size(); i < size; ++i) {
         std::vector<cv::Point>& contour = contours[i];
 
         // Skip blobs with perimeters which too small or too large perimeters
         double P = cv::arcLength(contour, false);
-        if(P < _blob_perimeter_min || P > _blob_perimeter_max)
+        if(P < _parameters->blob_perimeter_min || P > _parameters->blob_perimeter_max)
             continue;
 
         // Blob bounding rect
         cv::Rect blob_rect = cv::boundingRect(contour);
+        cv::Moments moments = cv::moments(contour);
+
+        // Reuse the crown test verdict of the same blob in the previous frame
+        BlobVerdict verdict;
+        verdict.rect = QRect(blob_rect.x, blob_rect.y, blob_rect.width, blob_rect.height);
+        verdict.area = moments.m00;
+        if(reuse_verdicts) {
+            const BlobVerdict* known = findBlobVerdict(verdict.rect, verdict.area);
+            if(known && known->age < _blob_verdict_max_age) {
+                verdict.accepted = known->accepted;
+                verdict.age = known->age + 1;
+                _blob_verdicts.push_back(verdict);
+                if(!verdict.accepted)
+                    continue;
+                cv::Mat blob(blob_rect.size(), CV_8UC1, cv::Scalar(0));
+                cv::drawContours(blob, contours, i, cv::Scalar(255), CV_FILLED, 4, cv::noArray(), 0, -blob_rect.tl());
+                setLaserPosition(blobCenter<T>((*v)(blob_rect), blob, QPoint(blob_rect.x, blob_rect.y), moments, DV_thresh));
+                return;
+            }
+        }
+
         // Enlarge blob rect for further processing of its crown
-        blob_rect.x = std::max<int>(0, blob_rect.x - _blob_crown_margin_sup);
-        blob_rect.y = std::max<int>(0, blob_rect.y - _blob_crown_margin_sup);
-        blob_rect.width = std::min<int>(v->cols - blob_rect.x, blob_rect.width + 2 * _blob_crown_margin_sup);
-        blob_rect.height = std::min<int>(v->rows - blob_rect.y, blob_rect.height + 2 * _blob_crown_margin_sup);
+        blob_rect.x = std::max<int>(0, blob_rect.x - _parameters->blob_crown_margin_sup);
+        blob_rect.y = std::max<int>(0, blob_rect.y - _parameters->blob_crown_margin_sup);
+        blob_rect.width = std::min<int>(v->cols - blob_rect.x, blob_rect.width + 2 * _parameters->blob_crown_margin_sup);
+        blob_rect.height = std::min<int>(v->rows - blob_rect.y, blob_rect.height + 2 * _parameters->blob_crown_margin_sup);
 
         // Blob subimage
         cv::Mat blob(blob_rect.size(), CV_8UC1, cv::Scalar(0));
         cv::drawContours(blob, contours, i, cv::Scalar(255), CV_FILLED, 4, cv::noArray(), 0, -blob_rect.tl());
 
-        // Blob crown subimage
-        cv::Mat blob_crown;
-        {
-            cv::Mat blob_dilated_inf;
-            if(_blob_crown_margin_inf == 0)
-                blob_dilated_inf = blob.clone();
-            else
-                cv::dilate(blob, blob_dilated_inf, cross, cv::Point(-1,-1), _blob_crown_margin_inf);
-
-            cv::dilate(blob_dilated_inf, blob_crown, cross, cv::Point(-1,-1), _blob_crown_margin_sup - _blob_crown_margin_inf);
-            // Subtract blob_crown from blob_crown
-            cv::bitwise_not(blob_dilated_inf, blob_dilated_inf);
-            cv::bitwise_and(blob_crown, blob_dilated_inf, blob_crown);
+        if(!CrownCheck) {
+            // No crown check
+            if(moments.m00 <= 0.)
+                continue;
+            if(EmitFilteredImages) {
+                cv::Mat blob_with_crown;
+                cv::cvtColor(blob, blob_with_crown, CV_GRAY2BGR);
+                emit laserBlobAvailable(cvMat2QImage(blob_with_crown));
+            }
+            setLaserPosition(blobCenter<T>((*v)(blob_rect), blob, QPoint(blob_rect.x, blob_rect.y), moments, DV_thresh));
+            return;
         }
 
-        // Blob hue (color) subimage
-        cv::Mat blob_hue = (*h)(blob_rect);
-        // Binarize blob hue according to the valid laser hue range
-        if(_hue_min <= _hue_max)
-            blob_hue = blob_hue >= _hue_min & blob_hue <= _hue_max;
-        else /*if(_hue_min > _hue_max)*/
-            blob_hue = blob_hue >= _hue_min | blob_hue <= _hue_max;
-
-        // Count crown pixels and crown pixels with valid colors
-        int nb_crown_pixels = 0;
-        int nb_valid_crown_pixels = 0;
-        for(int i = 0, height = blob_rect.height; i < height; ++i)
-            for(int j = 0, width = blob_rect.width; j < width; ++j) {
-                if(blob_crown.at<uchar>(i, j) == 0)
-                    // Not a crawn pixel
-                    continue;
-                ++nb_crown_pixels;
+        // Blob crown subimage: the blob dilated by the outer margin minus
+        // the blob dilated by the inner margin (on bits)
+        BitMask blob_bits;
+        blob_bits.fromBytes(blob.data, blob.cols, blob.rows, blob.step);
+        BitMask blob_crown;
+        blob_bits.dilate(_parameters->crown_sup_kernel, blob_crown);
+        if(_parameters->blob_crown_margin_inf == 0)
+            blob_crown.subtract(blob_bits);
+        else {
+            BitMask blob_dilated_inf;
+            blob_bits.dilate(_parameters->crown_inf_kernel, blob_dilated_inf);
+            blob_crown.subtract(blob_dilated_inf);
+        }
+        if(!_detection_mask.isFull() && _detection_mask.size() == QSize(v->cols, v->rows)) {
+            // Masked out pixels are black, not crown pixels.
+            BitMask active;
+            activeBits(QRect(blob_rect.x, blob_rect.y, blob_rect.width, blob_rect.height), active);
+            blob_crown.intersect(active);
+        }
 
-                if(blob_hue.at<uchar>(i, j) == 0)
-                    // Color of the crown pixel isn't valid
-                    continue;
-                ++nb_valid_crown_pixels;
-            }
+        // Count crown pixels and crown pixels with valid colors (hue in the
+        // laser hue range)
+        BitMask valid_hue;
+        validHueBits(rgb_mat, QRect(blob_rect.x, blob_rect.y, blob_rect.width, blob_rect.height), blob_crown, valid_hue);
+        const int nb_crown_pixels = blob_crown.count();
+        const int nb_valid_crown_pixels = blob_crown.countAnd(valid_hue);
 
         // Chech if threre's enough valid crawn pixels and compute the laser blob center, if any.
-        cv::Moments moments = cv::moments(contour);
-        if(moments.m00 > 0. && nb_crown_pixels > 0 && static_cast<double>(nb_valid_crown_pixels) / nb_crown_pixels >= _blob_crown_valid_pixels_part_min) {
-            if(_emit_filtered_images) {
+        verdict.accepted = moments.m00 > 0. && nb_crown_pixels > 0 && static_cast<double>(nb_valid_crown_pixels) / nb_crown_pixels >= _parameters->blob_crown_valid_pixels_part_min;
+        verdict.age = 0;
+        _blob_verdicts.push_back(verdict);
+        if(verdict.accepted) {
+            if(EmitFilteredImages) {
                 // color output (BGR format)
                 cv::Mat blob_with_crown(blob_rect.size(), CV_8UC3, cv::Scalar(0, 0, 0));
                 for(int i = 0, height = blob_rect.height; i < height; ++i)
@@ -174,8 +502,8 @@ void LaserDetector::run(const QImage& image) const
                             blob_with_crown.at<cv::Vec3b>(i, j)[1] = 255;
                             blob_with_crown.at<cv::Vec3b>(i, j)[2] = 255;
                         }
-                        if(blob_crown.at<uchar>(i, j) != 0) {
-                            if(blob_hue.at<uchar>(i, j) == 0)
+                        if(blob_crown.at(j, i)) {
+                            if(!valid_hue.at(j, i))
                                 blob_with_crown.at<cv::Vec3b>(i, j)[2] = 255;
                             else
                                 blob_with_crown.at<cv::Vec3b>(i, j)[1] = 255;
@@ -183,73 +511,465 @@ void LaserDetector::run(const QImage& image) const
                     }
                 emit laserBlobAvailable(cvMat2QImage(blob_with_crown));
             }
-            emit laserPosition(center(moments));
+            setLaserPosition(blobCenter<T>((*v)(blob_rect), blob, QPoint(blob_rect.x, blob_rect.y), moments, DV_thresh));
             return;
         }
     }
 
-    emit laserPosition(QPointF(), false);
+    setLaserPosition(QPointF(), false);
+}
+
+template<typename T, bool CrownCheck>
+LaserDetector::DetectFunction LaserDetector::detectVariant(bool closing, bool emit_filtered_images)
+{
+    if(closing)
+        return emit_filtered_images ?
+            &LaserDetector::detect<T, CrownCheck, true, true> :
+            &LaserDetector::detect<T, CrownCheck, true, false>;
+    return emit_filtered_images ?
+        &LaserDetector::detect<T, CrownCheck, false, true> :
+        &LaserDetector::detect<T, CrownCheck, false, false>;
+}
+
+void LaserDetector::selectDetect(QImage::Format format)
+{
+    _detect_format = format;
+    const bool closing = _parameters->blob_closing_enabled && _parameters->blob_closing_size > 0;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    if(format == QImage::Format_Grayscale16) {
+        _detect = detectVariant<quint16, false>(closing, _parameters->emit_filtered_images);
+        return;
+    }
+#endif
+    // Grayscale input (monochrome cameras) has no crown color.
+    if(_parameters->luminance_only || format == QImage::Format_Grayscale8)
+        _detect = detectVariant<uchar, false>(closing, _parameters->emit_filtered_images);
+    else
+        _detect = detectVariant<uchar, true>(closing, _parameters->emit_filtered_images);
+}
+
+void LaserDetector::setLaserPosition(const QPointF& pos, bool found)
+{
+    _has_last_position = true;
+    _last_position = pos;
+    _last_position_found = found;
+    emit laserPosition(pos, found);
+}
+
+bool LaserDetector::updateTiles(const QImage& image)
+{
+    int nb_channels;
+    bool is_16_bit = false;
+    switch(image.format()) {
+    case QImage::Format_RGB888:
+        nb_channels = 3;
+        break;
+    case QImage::Format_Grayscale8:
+        nb_channels = 1;
+        break;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    case QImage::Format_Grayscale16:
+        nb_channels = 1;
+        is_16_bit = true;
+        break;
+#endif
+    default:
+        // Not supported, always changed
+        _tiles_valid = false;
+        return true;
+    }
+
+    const int nb_tile_cols = (image.width() + _tile_size - 1) / _tile_size;
+    const int nb_tile_rows = (image.height() + _tile_size - 1) / _tile_size;
+    const int nb_tiles = nb_tile_cols * nb_tile_rows;
+    const int nb_block_cols = (image.width() + _block_size - 1) / _block_size;
+    const int nb_block_rows = (image.height() + _block_size - 1) / _block_size;
+    const int nb_blocks = nb_block_cols * nb_block_rows;
+    bool changed = !_tiles_valid || image.size() != _tiles_image_size;
+    _tiles_image_size = image.size();
+    _tiles_valid = true;
+
+    qSwap(_tile_maxima, _previous_tile_maxima);
+    qSwap(_block_sums, _previous_block_sums);
+    _tile_maxima.fill(0, nb_tiles);
+    _block_sums.fill(0, nb_blocks);
+    if(is_16_bit)
+        tileStatistics<quint16>(image, nb_channels, _tile_size, nb_tile_cols, _block_size, nb_block_cols, _tile_maxima.data(), _block_sums.data());
+    else
+        tileStatistics<uchar>(image, nb_channels, _tile_size, nb_tile_cols, _block_size, nb_block_cols, _tile_maxima.data(), _block_sums.data());
+
+    // Tolerances to the camera noise
+    const int max_tolerance = is_16_bit ? _tile_max_tolerance * 257 : _tile_max_tolerance;
+    const qint64 sum_tolerance = static_cast<qint64>(is_16_bit ? _block_mean_tolerance * 257 : _block_mean_tolerance) *
+        _block_size * _block_size * nb_channels;
+    _tiles_brightness_max = 0;
+    for(int k = 0; k < nb_tiles; ++k) {
+        _tiles_brightness_max = qMax<int>(_tiles_brightness_max, _tile_maxima[k]);
+        if(!changed && qAbs(_tile_maxima[k] - _previous_tile_maxima[k]) > max_tolerance)
+            changed = true;
+    }
+    // Decimated images: a dot moving inside a tile changes block sums.
+    for(int k = 0; k < nb_blocks && !changed; ++k)
+        if(qAbs(static_cast<qint64>(_block_sums[k]) - _previous_block_sums[k]) > sum_tolerance)
+            changed = true;
+    return changed;
+}
+
+void LaserDetector::setSkipStaticFrames(bool enabled)
+{
+    _next_parameters.skip_static_frames = enabled;
+
+    publishParameters();
+}
+
+void LaserDetector::setStreamingThreshold(bool enabled)
+{
+    _next_parameters.streaming_threshold = enabled;
+
+    publishParameters();
 }
 
 void LaserDetector::setHighestBrightnessMin(int min)
 {
     Q_ASSERT(min >= 0 && min <= 255);
 
-    _highest_brightness_min = min;
+    _next_parameters.highest_brightness_min = min;
+
+    publishParameters();
 }
 
 void LaserDetector::setRelativeBrightnessMin(double min)
 {
     Q_ASSERT(min >= 0. && min <= 1.);
 
-    _relative_brightness_min = min;
+    _next_parameters.relative_brightness_min = min;
+
+    publishParameters();
 }
 
 void LaserDetector::setBlobClosingSize(uint size)
 {
-    _blob_closing_size = size;
+    _next_parameters.blob_closing_size = size;
+    if(size > 0)
+        _next_parameters.closing_kernel = BitMask::ellipse(size);
+
+    publishParameters();
+}
+
+void LaserDetector::setBlobClosingEnabled(bool enabled)
+{
+    _next_parameters.blob_closing_enabled = enabled;
+
+    publishParameters();
 }
 
 void LaserDetector::setNbBlobsMax(int max)
 {
     Q_ASSERT(max > 0);
 
-    _nb_blobs_max = max;
+    _next_parameters.nb_blobs_max = max;
+
+    publishParameters();
 }
 
 void LaserDetector::setBlobCrownMargins(int inf, int sup)
 {
     Q_ASSERT(inf >= 0 && inf < sup);
 
-    _blob_crown_margin_inf = inf;
-    _blob_crown_margin_sup = sup;
+    _next_parameters.blob_crown_margin_inf = inf;
+    _next_parameters.blob_crown_margin_sup = sup;
+    // Same as inf and sup iterations of the 3x3 cross dilation
+    _next_parameters.crown_inf_kernel = BitMask::diamond(inf);
+    _next_parameters.crown_sup_kernel = BitMask::diamond(sup);
+
+    publishParameters();
 }
 
 void LaserDetector::setBlobPerimeterRange(uint min, uint max)
 {
     Q_ASSERT(min > 0 && min < max);
 
-    _blob_perimeter_min = min;
-    _blob_perimeter_max = max;
+    _next_parameters.blob_perimeter_min = min;
+    _next_parameters.blob_perimeter_max = max;
+
+    publishParameters();
 }
 
 void LaserDetector::setHueRange(uchar min, uchar max)
 {
     Q_ASSERT(min < 180 && max < 180);
 
-    _hue_min = min;
-    _hue_max = max;
+    _next_parameters.hue_min = min;
+    _next_parameters.hue_max = max;
+    updateHueLut();
+
+    publishParameters();
 }
 void LaserDetector::setBlobCrownValidPixelsPartMin(double min)
 {
     Q_ASSERT(min >= 0. && min <= 1.);
 
-    _blob_crown_valid_pixels_part_min = min;
+    _next_parameters.blob_crown_valid_pixels_part_min = min;
+
+    publishParameters();
+}
+
+void LaserDetector::setLuminanceOnly(bool enabled)
+{
+    _next_parameters.luminance_only = enabled;
+
+    publishParameters();
+}
+
+void LaserDetector::setCenterMode(CenterMode mode)
+{
+    _next_parameters.center_mode = mode;
+
+    publishParameters();
 }
 
 void LaserDetector::setEmitFilteredImages(bool do_emit)
 {
-    _emit_filtered_images = do_emit;
+    _next_parameters.emit_filtered_images = do_emit;
+
+    publishParameters();
+}
+
+void LaserDetector::setHotspotLearning(bool enabled)
+{
+    _next_parameters.hotspot_learning = enabled;
+
+    publishParameters();
+}
+
+void LaserDetector::publishParameters()
+{
+    // A replaced snapshot was not taken by run(), nobody else holds it.
+    delete _published_parameters.fetchAndStoreRelease(new Parameters(_next_parameters));
+}
+
+void LaserDetector::updateParameters()
+{
+    Parameters* parameters = _published_parameters.fetchAndStoreAcquire(0);
+    if(!parameters)
+        return;
+    _parameters.reset(parameters);
+
+    // Results and caches of the previous parameters
+    _has_last_position = false;
+    _blob_verdicts.clear();
+    _last_threshold = -1;
+    _detect = 0;
+}
+
+void LaserDetector::clearHotspots()
+{
+    _hotspot_frame_map = QImage();
+    _hotspot_counts.fill(0);
+    _hotspot_map.fill(0);
+    _hotspot_free_map.fill(255);
+    _nb_hotspots = 0;
+
+    _has_last_position = false;
+}
+
+void LaserDetector::setHotspotMap(const QImage& map)
+{
+    _hotspot_frame_map = map.isNull() ? QImage() : map.convertToFormat(QImage::Format_Grayscale8);
+    readHotspots();
+
+    _has_last_position = false;
+}
+
+void LaserDetector::setFrameGeometry(const QSize& frame_size, const QRect& roi, const QSize& size)
+{
+    _geometry_frame_size = frame_size;
+    _geometry_roi = roi;
+    _geometry_size = size;
+}
+
+void LaserDetector::setDetectionMask(const DetectionMask& mask)
+{
+    _detection_mask = mask;
+    // Crowns of known blobs changed
+    _blob_verdicts.clear();
+}
+
+QImage LaserDetector::hotspotMap() const
+{
+    QImage map = _hotspot_frame_map;
+    writeHotspots(map);
+    return map;
+}
+
+bool LaserDetector::updateHotspotGeometry(const QSize& size)
+{
+    // Unknown geometry: entire frames
+    const bool known = size == _geometry_size;
+    const QSize frame_size = known ? _geometry_frame_size : size;
+    const QRect roi = known ? _geometry_roi : QRect(QPoint(), size);
+    if(size == _hotspots_size && frame_size == _hotspots_frame_size && roi == _hotspots_roi)
+        return false;
+
+    // Keep hotspots learned in the previous geometry.
+    writeHotspots(_hotspot_frame_map);
+
+    _hotspots_size = size;
+    _hotspots_frame_size = frame_size;
+    _hotspots_roi = roi;
+    readHotspots();
+    return true;
+}
+
+void LaserDetector::writeHotspots(QImage& map) const
+{
+    if(_hotspots_size.isEmpty() || _hotspots_frame_size.isEmpty())
+        return;
+    if(map.isNull()) {
+        if(_nb_hotspots == 0)
+            return;
+        map = QImage(_hotspots_frame_size, QImage::Format_Grayscale8);
+        map.fill(0);
+    }
+
+    const QVector<int> x_bounds = hotspotMapBounds(_hotspots_frame_size.width(), _hotspots_roi.left(), _hotspots_roi.width(), _hotspots_size.width(), map.width());
+    const QVector<int> y_bounds = hotspotMapBounds(_hotspots_frame_size.height(), _hotspots_roi.top(), _hotspots_roi.height(), _hotspots_size.height(), map.height());
+    const uchar* hotspots = reinterpret_cast<const uchar*>(_hotspot_map.constData());
+    for(int i = 0, k = 0; i < _hotspots_size.height(); ++i)
+        for(int j = 0; j < _hotspots_size.width(); ++j, ++k) {
+            // Only pixels learned or released since the map was read
+            // change their block: the map keeps its resolution.
+            const bool hotspot = hotspots[k] != 0;
+            if(hotspotMapBlock(map, x_bounds, y_bounds, j, i) == hotspot)
+                continue;
+            for(int y = y_bounds[i]; y < blockEnd(y_bounds, i, map.height()); ++y) {
+                uchar* line = map.scanLine(y);
+                for(int x = x_bounds[j]; x < blockEnd(x_bounds, j, map.width()); ++x)
+                    line[x] = hotspot ? 255 : 0;
+            }
+        }
+}
+
+void LaserDetector::readHotspots()
+{
+    const int nb_pixels = _hotspots_size.width() * _hotspots_size.height();
+    _hotspot_counts.resize(nb_pixels);
+    _hotspot_map.resize(nb_pixels);
+    _hotspot_free_map.resize(nb_pixels);
+    _nb_hotspots = 0;
+    if(_hotspot_frame_map.isNull() || _hotspots_frame_size.isEmpty()) {
+        _hotspot_counts.fill(0);
+        _hotspot_map.fill(0);
+        _hotspot_free_map.fill(255);
+        return;
+    }
+
+    // An input pixel is a hotspot if the frame map has hotspots in its
+    // block (the laser isn't detected in a block with a lamp).
+    const QVector<int> x_bounds = hotspotMapBounds(_hotspots_frame_size.width(), _hotspots_roi.left(), _hotspots_roi.width(), _hotspots_size.width(), _hotspot_frame_map.width());
+    const QVector<int> y_bounds = hotspotMapBounds(_hotspots_frame_size.height(), _hotspots_roi.top(), _hotspots_roi.height(), _hotspots_size.height(), _hotspot_frame_map.height());
+    for(int i = 0, k = 0; i < _hotspots_size.height(); ++i)
+        for(int j = 0; j < _hotspots_size.width(); ++j, ++k) {
+            const bool hotspot = hotspotMapBlock(_hotspot_frame_map, x_bounds, y_bounds, j, i);
+            _hotspot_counts[k] = hotspot ? static_cast<char>(_hotspot_count_max) : 0;
+            _hotspot_map[k] = hotspot ? 255 : 0;
+            _hotspot_free_map[k] = hotspot ? 0 : 255;
+            _nb_hotspots += hotspot;
+        }
+}
+
+void LaserDetector::learnHotspots(const cv::Mat& bright)
+{
+    Q_ASSERT(bright.type() == CV_8UC1 && QSize(bright.cols, bright.rows) == _hotspots_size);
+
+    uchar* counts = (uchar*) _hotspot_counts.data();
+    uchar* map = (uchar*) _hotspot_map.data();
+    uchar* free_map = (uchar*) _hotspot_free_map.data();
+    for(int i = 0, k = 0; i < bright.rows; ++i) {
+        const uchar* line = bright.ptr<uchar>(i);
+        for(int j = 0; j < bright.cols; ++j, ++k) {
+            if(line[j]) {
+                if(counts[k] < _hotspot_count_max && ++counts[k] == _hotspot_learned_count && !map[k]) {
+                    map[k] = 255;
+                    free_map[k] = 0;
+                    ++_nb_hotspots;
+                }
+            } else if(counts[k] > 0 && --counts[k] == 0 && map[k]) {
+                map[k] = 0;
+                free_map[k] = 255;
+                --_nb_hotspots;
+            }
+        }
+    }
+}
+
+void LaserDetector::activeBits(const QRect& rect, BitMask& result) const
+{
+    result.create(rect.width(), rect.height());
+    for(int i = 0; i < rect.height(); ++i)
+        for(const DetectionMask::Span* span = _detection_mask.rowBegin(rect.y() + i), *end = _detection_mask.rowEnd(rect.y() + i); span < end; ++span) {
+            const int begin = qMax(span->begin, rect.left()) - rect.left();
+            const int span_end = qMin(span->end, rect.left() + rect.width()) - rect.left();
+            if(begin < span_end)
+                result.fillSpan(i, begin, span_end);
+        }
+}
+
+void LaserDetector::validHueBits(const cv::Mat& rgb, const QRect& rect, const BitMask& mask, BitMask& result) const
+{
+    result.create(rect.width(), rect.height());
+    const int nb_words = (rect.width() + 63) / 64;
+    for(int i = 0; i < rect.height(); ++i) {
+        const quint64* mask_row = mask.row(i);
+        quint64* result_row = result.row(i);
+        const uchar* line = rgb.ptr<uchar>(rect.y() + i) + 3 * rect.x();
+        for(int k = 0; k < nb_words; ++k) {
+            if(mask_row[k] == 0)
+                continue;
+            quint64 word = 0;
+            const uchar* pixel = line + 3 * 64 * k;
+            for(int b = 0, end = qMin(64, rect.width() - 64 * k); b < end; ++b, pixel += 3)
+                if(isValidHue(pixel))
+                    word |= quint64(1) << b;
+            result_row[k] = word;
+        }
+    }
+}
+
+void LaserDetector::updateHueLut()
+{
+    // Hues of centers of quantization cells
+    _next_parameters.hue_lut.fill(0, (1 << 3 * _hue_lut_bits) / 64);
+    const int cell_center = 1 << (7 - _hue_lut_bits);
+    const int channel_mask = (1 << _hue_lut_bits) - 1;
+    for(int index = 0, size = 1 << 3 * _hue_lut_bits; index < size; ++index) {
+        const int h = hue(
+            ((index >> 2 * _hue_lut_bits) << (8 - _hue_lut_bits)) | cell_center,
+            (((index >> _hue_lut_bits) & channel_mask) << (8 - _hue_lut_bits)) | cell_center,
+            ((index & channel_mask) << (8 - _hue_lut_bits)) | cell_center
+        );
+        const bool valid = _next_parameters.hue_min <= _next_parameters.hue_max ?
+            h >= _next_parameters.hue_min && h <= _next_parameters.hue_max :
+            h >= _next_parameters.hue_min || h <= _next_parameters.hue_max;
+        if(valid)
+            _next_parameters.hue_lut[index >> 6] |= quint64(1) << (index & 63);
+    }
+}
+
+const LaserDetector::BlobVerdict* LaserDetector::findBlobVerdict(const QRect& rect, double area) const
+{
+    for(int i = 0, size = _previous_blob_verdicts.size(); i < size; ++i) {
+        const BlobVerdict& verdict = _previous_blob_verdicts[i];
+        if(
+            qAbs(verdict.rect.x() - rect.x()) <= _blob_verdict_tolerance &&
+            qAbs(verdict.rect.y() - rect.y()) <= _blob_verdict_tolerance &&
+            qAbs(verdict.rect.width() - rect.width()) <= _blob_verdict_tolerance &&
+            qAbs(verdict.rect.height() - rect.height()) <= _blob_verdict_tolerance &&
+            qAbs(verdict.area - area) <= _blob_verdict_area_tolerance * qMax(verdict.area, area)
+        )
+            return &verdict;
+    }
+    return 0;
 }
 
 QPointF LaserDetector::center(const cv::Moments& moments) const
@@ -275,6 +995,26 @@ cv::Mat LaserDetector::QImage2cvMat(const QImage& image) const
     return cv::Mat(rgb_image.height(), rgb_image.width(), CV_8UC3, (void*) rgb_image.scanLine(0), rgb_image.bytesPerLine()).clone();
 }
 
+cv::Mat LaserDetector::QImage2cvGrayMat(const QImage& image) const
+{
+    Q_ASSERT(isGrayscale(image));
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    if(image.format() == QImage::Format_Grayscale16)
+        return cv::Mat(image.height(), image.width(), CV_16UC1, (void*) image.constBits(), image.bytesPerLine());
+#endif
+    return cv::Mat(image.height(), image.width(), CV_8UC1, (void*) image.constBits(), image.bytesPerLine());
+}
+
+bool LaserDetector::isGrayscale(const QImage& image)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    if(image.format() == QImage::Format_Grayscale16)
+        return true;
+#endif
+    return image.format() == QImage::Format_Grayscale8;
+}
+
 QImage LaserDetector::cvMat2QImage(const cv::Mat& mat, bool binarize) const
 {
     Q_ASSERT(mat.type() == CV_8UC1 || mat.type() == CV_8UC3);
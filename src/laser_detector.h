@@ -2,10 +2,18 @@
 #define LASER_DETECTOR_H
 
 #include <QObject>
+#include <QSize>
+#include <QRect>
+#include <QByteArray>
+#include <QImage>
 
-class QImage;
-class QPointF;
-class QSize;
+#include <QPointF>
+#include <QVector>
+#include <QAtomicPointer>
+#include <QScopedPointer>
+
+#include "bit_mask.h"
+#include "detection_mask.h"
 
 namespace cv {
     class Mat;
@@ -30,6 +38,10 @@ public:
     /// the detected laser blob(s) candidates before filtering. If zero,
     /// no closing will be performed.
     ///
+    /// @param luminance_only detect blobs by brightness only, skip the
+    /// crown color (hue) check. Always the case for grayscale input images
+    /// (monochrome cameras).
+    ///
     /// @param emit_filtered_images emit thresholded blobs and a detected blob,
     /// if any.
     explicit LaserDetector
@@ -47,25 +59,80 @@ public:
         uchar hue_min = 0,
         uchar hue_max = 179,
         double blob_crown_valid_pixels_part_min = 0.66,
+        bool luminance_only = false,
 
         bool emit_filtered_images = false
     );
+    ~LaserDetector();
+
+    /// Position of the laser dot in its blob
+    enum CenterMode {
+        // Center of the blob shape
+        ContourCenter,
+        // Center of the blob brightness
+        WeightedCenter,
+        // Peak of Gaussians fitted to the blob brightness projections
+        GaussianCenter
+    };
 
 public slots:
     /// Run the detection for the input image @param image.
     /// @retval laserPosition signal
-    void run(const QImage& image) const;
+    void run(const QImage& image);
+
+    // Parameter setters can be called from another thread than run() (one
+    // at a time). Parameters are applied from the next frame.
 
     void setHighestBrightnessMin(int min);
     void setRelativeBrightnessMin(double min);
     void setBlobClosingSize(uint size);
+    /// Temporarily disable the blob closing if not @param enabled (the
+    /// closing size is kept).
+    void setBlobClosingEnabled(bool enabled);
     void setNbBlobsMax(int max);
     void setBlobCrownMargins(int inf, int sup);
     void setBlobPerimeterRange(uint min, uint max);
     void setHueRange(uchar min, uchar max);
     void setBlobCrownValidPixelsPartMin(double min);
+    void setLuminanceOnly(bool enabled);
+    void setCenterMode(CenterMode mode);
 
     void setEmitFilteredImages(bool do_emit);
+    /// If @param enabled, frames without changes (compared by tiles to the
+    /// previous frame) are not processed while no laser dot is found, the
+    /// previous result is emitted.
+    void setSkipStaticFrames(bool enabled);
+    /// If @param enabled and the brightness maximum isn't known in advance
+    /// (hotspots), frames are thresholded by the threshold of the previous
+    /// frame in the pass searching the maximum. They are thresholded again
+    /// only if the threshold changed.
+    void setStreamingThreshold(bool enabled);
+
+    /// Learn hotspots: pixels which stay bright for a long time (lamps,
+    /// reflections). Hotspots are ignored by the detection.
+    void setHotspotLearning(bool enabled);
+
+    // The following slots and hotspotMap() access the detection state
+    // used by run() without synchronization: they must be called from the
+    // thread of run() (the detector's thread), or through queued
+    // connections.
+
+    void clearHotspots();
+    /// Set the hotspot map @param map of entire camera frames (hotspots are
+    /// nonzero, any resolution). It is cropped and decimated to the input
+    /// images by their geometry.
+    void setHotspotMap(const QImage& map);
+    /// The input images of size @param size are the region @param roi of
+    /// frames of size @param frame_size (@see ImageModifier). Without it,
+    /// input images are entire frames.
+    void setFrameGeometry(const QSize& frame_size, const QRect& roi, const QSize& size);
+    /// Set the detection mask @param mask of the input images: masked out
+    /// pixels (black) are not counted in blob crowns.
+    void setDetectionMask(const DetectionMask& mask);
+
+public:
+    /// @see setHotspotMap()
+    QImage hotspotMap() const;
 
 signals:
     /// Emit a laser dot position @param pos in the input image coordinates,
@@ -78,32 +145,213 @@ signals:
     void warning(const QString& text) const;
 
 private:
+    // Detect the laser dot in @param image.
+    // Variants are compiled for the value type T (uchar or quint16), with
+    // or without the crown color check (CrownCheck), the blob closing
+    // (Closing) and filtered images (EmitFilteredImages).
+    template<typename T, bool CrownCheck, bool Closing, bool EmitFilteredImages>
+    void detect(const QImage& image);
+    typedef void (LaserDetector::*DetectFunction)(const QImage& image);
+    template<typename T, bool CrownCheck>
+    static DetectFunction detectVariant(bool closing, bool emit_filtered_images);
+    // Select the detection variant for input images of the format
+    // @param format and the current parameters.
+    void selectDetect(QImage::Format format);
+    // Keep and emit the detection result.
+    void setLaserPosition(const QPointF& pos, bool found = true);
+    // Update brightness maxima of tiles and sums of blocks of @param image.
+    // @return false if no tile or block changed since the previous image.
+    bool updateTiles(const QImage& image);
     // Compute center by moments. Area (m00) should be positive.
     inline QPointF center(const cv::Moments& moments) const;
+    // Compute the center of the blob @param blob (nonzero pixels) at
+    // @param offset by the center mode. @param value is the brightness of
+    // the blob pixels, thresholded by @param threshold. @param moments are
+    // moments of the blob contour.
+    template<typename T>
+    QPointF blobCenter(const cv::Mat& value, const cv::Mat& blob, const QPoint& offset, const cv::Moments& moments, int threshold) const;
     // Convert a QImage @param image to a RGB cv::Mat
     cv::Mat QImage2cvMat(const QImage& image) const;
+    // Wrap a grayscale QImage @param image (Format_Grayscale8 or
+    // Format_Grayscale16) into a CV_8UC1 or CV_16UC1 cv::Mat without copy.
+    cv::Mat QImage2cvGrayMat(const QImage& image) const;
+    static inline bool isGrayscale(const QImage& image);
     // Convert cv::Mat to a QImage (valid formats are CV_8U1 and CV_8U3 (BGR))
     // If @param binarize is true and format is CV_8U1, nowmalize @param mat
     // to obtain a black/white (0/255) image.
     QImage cvMat2QImage(const cv::Mat& mat, bool binarize = false) const;
 
+    // Publish the parameters set by setters to run().
+    void publishParameters();
+    // Take the last published parameters, if any.
+    void updateParameters();
+    // Rebuild the hue lookup table for the hue range of the next
+    // parameters.
+    void updateHueLut();
+    // The hue of the RGB pixel @param rgb is in the hue range.
+    inline bool isValidHue(const uchar* rgb) const;
+    // Set @param result to the pixels of @param rect of the RGB image
+    // @param rgb with valid hues. Only words of @param mask (of the rect
+    // size) with set pixels are looked up, others are cleared.
+    void validHueBits(const cv::Mat& rgb, const QRect& rect, const BitMask& mask, BitMask& result) const;
+
+    // Set @param result to the active pixels of the detection mask in
+    // @param rect.
+    void activeBits(const QRect& rect, BitMask& result) const;
+
+    // Crown test verdict of a blob
+    struct BlobVerdict {
+        // Bounding rect and area of the blob
+        QRect rect;
+        double area;
+        bool accepted;
+        // Frames the verdict was reused for
+        int age;
+    };
+    // Find the verdict of a blob of the previous frame matching the blob
+    // with bounding rect @param rect and area @param area, if any.
+    const BlobVerdict* findBlobVerdict(const QRect& rect, double area) const;
+
+    // Update hotspot data for input images of size @param size: the
+    // learned hotspots are written to the frame map, which is cropped and
+    // decimated to the new input images.
+    // @return false if their geometry didn't change.
+    bool updateHotspotGeometry(const QSize& size);
+    // Write hotspots learned since they were read from @param map (frame
+    // map) into @param map.
+    void writeHotspots(QImage& map) const;
+    // Read hotspots of the input images from the frame map.
+    void readHotspots();
+    // Count successive (learning) frames where pixels are bright
+    // (@param bright is nonzero), update the hotspot map.
+    void learnHotspots(const cv::Mat& bright);
+
 private:
-    uchar _highest_brightness_min;
-    double _relative_brightness_min;
-    uint _blob_closing_size;
-    uint _nb_blobs_max;
-    uint _blob_perimeter_min;
-    uint _blob_perimeter_max;
-    uint _blob_crown_margin_inf;
-    uint _blob_crown_margin_sup;
-    uchar _hue_min;
-    uchar _hue_max;
-    // Crown pixels with valid colors (defined by range of hue_{min,max}).
-    double _blob_crown_valid_pixels_part_min;
-
-    bool _emit_filtered_images;
+    // Detection parameters. run() uses an immutable snapshot of them, taken
+    // at the frame start, so setters can be called from another thread
+    // without tearing a parameter set in the middle of a frame.
+    struct Parameters {
+        uchar highest_brightness_min;
+        double relative_brightness_min;
+        uint blob_closing_size;
+        bool blob_closing_enabled;
+        BitMask::Kernel closing_kernel;
+        uint nb_blobs_max;
+        uint blob_perimeter_min;
+        uint blob_perimeter_max;
+        uint blob_crown_margin_inf;
+        uint blob_crown_margin_sup;
+        BitMask::Kernel crown_inf_kernel;
+        BitMask::Kernel crown_sup_kernel;
+        uchar hue_min;
+        uchar hue_max;
+        // Valid hues of RGB colors quantized to _hue_lut_bits per channel,
+        // one bit per color
+        QVector<quint64> hue_lut;
+        // Crown pixels with valid colors (defined by range of hue_{min,max}).
+        double blob_crown_valid_pixels_part_min;
+        bool luminance_only;
+        CenterMode center_mode;
+        bool emit_filtered_images;
+        bool hotspot_learning;
+        bool skip_static_frames;
+        bool streaming_threshold;
+    };
+    // Parameters modified by setters
+    Parameters _next_parameters;
+    // Snapshot published by the last setter and not taken by run() yet, if
+    // any. Snapshots are handed over by atomic exchanges: no locks, and a
+    // snapshot is never deleted while in use.
+    QAtomicPointer<Parameters> _published_parameters;
+    // Snapshot used by run()
+    QScopedPointer<const Parameters> _parameters;
+    static const int _hue_lut_bits = 6;
+
+    // Detection mask of the input images
+    DetectionMask _detection_mask;
+
+    // Closed blobs and the dilated intermediate
+    BitMask _closing_bits;
+    BitMask _closing_buffer;
+    // Beyond this number of blob groups, the entire frame is closed.
+    static const int _closing_nb_groups_max = 32;
+
+    // Hotspots (nonzero) of entire frames, in Format_Grayscale8 of any
+    // resolution. The hotspot data below is for the input images, which
+    // are the region _hotspots_roi of frames of size _hotspots_frame_size.
+    QImage _hotspot_frame_map;
+    QSize _hotspots_size;
+    QSize _hotspots_frame_size;
+    QRect _hotspots_roi;
+    // Input image geometry (@see setFrameGeometry())
+    QSize _geometry_frame_size;
+    QRect _geometry_roi;
+    QSize _geometry_size;
+    // Per pixel count of bright learning frames, increased when bright,
+    // decreased otherwise.
+    QByteArray _hotspot_counts;
+    // Hotspots (255) and other pixels (0), and the inverse.
+    QByteArray _hotspot_map;
+    QByteArray _hotspot_free_map;
+    int _nb_hotspots;
+    uint _frame_index;
+    // Hotspots are learned every _hotspot_learning_period frames.
+    static const int _hotspot_learning_period = 8;
+    // A pixel becomes a hotspot when its count reaches
+    // _hotspot_learned_count, and is released when it reaches 0.
+    static const int _hotspot_learned_count = 64;
+    static const int _hotspot_count_max = 2 * _hotspot_learned_count;
+
+    // Change detection
+    bool _tiles_valid;
+    QSize _tiles_image_size;
+    QVector<quint16> _tile_maxima;
+    QVector<quint16> _previous_tile_maxima;
+    QVector<quint32> _block_sums;
+    QVector<quint32> _previous_block_sums;
+    // Maximum of all tiles (brightness for RGB images)
+    int _tiles_brightness_max;
+    static const int _tile_size = 16; // pixels
+    static const int _block_size = 4; // pixels, divides _tile_size
+    // Tile maximum and block mean changes (in 8-bit levels) below these
+    // tolerances are noise.
+    static const int _tile_max_tolerance = 8;
+    static const int _block_mean_tolerance = 2;
+
+    // Brightness threshold of the previous frame, negative if none
+    int _last_threshold;
+
+    // Crown test verdicts of blobs of the previous and of the current frame
+    QVector<BlobVerdict> _previous_blob_verdicts;
+    QVector<BlobVerdict> _blob_verdicts;
+    // Verdicts are reused for blobs which moved or changed size by at most
+    // _blob_verdict_tolerance pixels and changed area by at most
+    // _blob_verdict_area_tolerance, and are reevaluated every
+    // _blob_verdict_max_age frames.
+    static const int _blob_verdict_tolerance = 1;
+    static const double _blob_verdict_area_tolerance;
+    static const int _blob_verdict_max_age = 30;
+
+    // Detection variant for _detect_format input images, reselected when
+    // null.
+    DetectFunction _detect;
+    QImage::Format _detect_format;
+
+    // Last result
+    bool _has_last_position;
+    QPointF _last_position;
+    bool _last_position_found;
 };
 
+bool LaserDetector::isValidHue(const uchar* rgb) const
+{
+    const int index =
+        ((rgb[0] >> (8 - _hue_lut_bits)) << 2 * _hue_lut_bits) |
+        ((rgb[1] >> (8 - _hue_lut_bits)) << _hue_lut_bits) |
+        (rgb[2] >> (8 - _hue_lut_bits));
+    return (_parameters->hue_lut[index >> 6] >> (index & 63)) & 1;
+}
+
 } // namespace laser_painter
 
 #endif // LASER_DETECTOR_H
\ No newline at end of file
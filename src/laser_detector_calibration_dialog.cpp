@@ -5,6 +5,10 @@
 #include <QSlider>
 #include <QSpinBox>
 #include <QDoubleSpinBox>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QPushButton>
+#include <QImage>
 #include <QHBoxLayout>
 #include <QVBoxLayout>
 #include <QGridLayout>
@@ -19,7 +23,8 @@ LaserDetectorCalibrationDialog::LaserDetectorCalibrationDialog(
     LaserDetector* laser_detector,
     QWidget* parent, Qt::WindowFlags f
 )
-    : QDialog(parent, f)
+    : QDialog(parent, f),
+    _laser_detector(laser_detector)
 {
     Q_ASSERT(laser_detector);
 
@@ -34,6 +39,7 @@ LaserDetectorCalibrationDialog::LaserDetectorCalibrationDialog(
     connect(this, &LaserDetectorCalibrationDialog::blobClosingSizeChanged, laser_detector, &LaserDetector::setBlobClosingSize);
     connect(this, &LaserDetectorCalibrationDialog::blobPerimeterRangeChanged, laser_detector, &LaserDetector::setBlobPerimeterRange);
     connect(this, &LaserDetectorCalibrationDialog::blobCrownMarginsChanged, laser_detector, &LaserDetector::setBlobCrownMargins);
+    connect(this, &LaserDetectorCalibrationDialog::centerModeChanged, laser_detector, &LaserDetector::setCenterMode);
     // Laser detector emits binary images for settings calibration when the widget is visible.
     connect(this, &LaserDetectorCalibrationDialog::visible, laser_detector, &LaserDetector::setEmitFilteredImages);
 
@@ -223,6 +229,80 @@ LaserDetectorCalibrationDialog::LaserDetectorCalibrationDialog(
     blob_crown_valid_pixels_part_min_lo->addWidget(blob_crown_valid_pixels_part_min_lb);
     blob_crown_valid_pixels_part_min_lo->addWidget(_blob_crown_valid_pixels_part_min_sb);
 
+    //// Luminance only ////
+    _luminance_only_cb = new QCheckBox();
+    QLabel* luminance_only_lb = new QLabel(tr("Luminance only:"));
+    luminance_only_lb->setToolTip(tr("Detect the laser dot by brightness only,\nwithout checking the crown color.\nAlways used with monochrome (IR) cameras."));
+    luminance_only_lb->setBuddy(_luminance_only_cb);
+    connect(_luminance_only_cb, &QCheckBox::toggled, laser_detector, &LaserDetector::setLuminanceOnly);
+    _luminance_only_cb->setChecked(settings.value("LaserDetectorCalibrationDialog/luminance_only", false).toBool());
+    QHBoxLayout* luminance_only_lo = new QHBoxLayout();
+    luminance_only_lo->addStretch();
+    luminance_only_lo->addWidget(luminance_only_lb);
+    luminance_only_lo->addWidget(_luminance_only_cb);
+
+    //// Center mode ////
+    _center_mode_cb = new QComboBox();
+    _center_mode_cb->addItem(tr("Contour"), LaserDetector::ContourCenter);
+    _center_mode_cb->addItem(tr("Weighted"), LaserDetector::WeightedCenter);
+    _center_mode_cb->addItem(tr("Gaussian"), LaserDetector::GaussianCenter);
+    connect(_center_mode_cb, SIGNAL(currentIndexChanged(int)), this, SLOT(emitCenterModeChanged()));
+    _center_mode_cb->setCurrentIndex(_center_mode_cb->findData(
+        settings.value("LaserDetectorCalibrationDialog/center_mode", LaserDetector::ContourCenter).toInt()));
+    emitCenterModeChanged();
+    QLabel* center_mode_lb = new QLabel(tr("Dot center:"));
+    center_mode_lb->setToolTip(tr("Contour: center of the blob shape (pixel precision).\nWeighted: center of the blob brightness (sub-pixel).\nGaussian: peak of Gaussians fitted to the blob brightness."));
+    center_mode_lb->setBuddy(_center_mode_cb);
+    QHBoxLayout* center_mode_lo = new QHBoxLayout();
+    center_mode_lo->addStretch();
+    center_mode_lo->addWidget(center_mode_lb);
+    center_mode_lo->addWidget(_center_mode_cb);
+
+    //// Hotspots ////
+    laser_detector->setHotspotMap(settings.value("LaserDetectorCalibrationDialog/hotspot_frame_map").value<QImage>());
+    _hotspot_learning_cb = new QCheckBox();
+    QLabel* hotspot_learning_lb = new QLabel(tr("Learn hotspots:"));
+    hotspot_learning_lb->setToolTip(tr("Learn pixels which stay bright for a long time\n(lamps, reflections) and ignore them.\nDon't keep the laser dot still while learning."));
+    hotspot_learning_lb->setBuddy(_hotspot_learning_cb);
+    connect(_hotspot_learning_cb, &QCheckBox::toggled, laser_detector, &LaserDetector::setHotspotLearning);
+    _hotspot_learning_cb->setChecked(settings.value("LaserDetectorCalibrationDialog/hotspot_learning", false).toBool());
+    QPushButton* clear_hotspots_bn = new QPushButton(tr("Clear"));
+    clear_hotspots_bn->setToolTip(tr("Forget learned hotspots."));
+    connect(clear_hotspots_bn, &QPushButton::clicked, laser_detector, &LaserDetector::clearHotspots);
+    QHBoxLayout* hotspot_lo = new QHBoxLayout();
+    hotspot_lo->addStretch();
+    hotspot_lo->addWidget(hotspot_learning_lb);
+    hotspot_lo->addWidget(_hotspot_learning_cb);
+    hotspot_lo->addWidget(clear_hotspots_bn);
+
+    //// Skip static frames ////
+    _skip_static_frames_cb = new QCheckBox();
+    QLabel* skip_static_frames_lb = new QLabel(tr("Skip static frames:"));
+    skip_static_frames_lb->setToolTip(tr("Don't process frames which didn't change\nsince the previous one (saves CPU when idle)."));
+    skip_static_frames_lb->setBuddy(_skip_static_frames_cb);
+    connect(_skip_static_frames_cb, &QCheckBox::toggled, laser_detector, &LaserDetector::setSkipStaticFrames);
+    _skip_static_frames_cb->setChecked(settings.value("LaserDetectorCalibrationDialog/skip_static_frames", true).toBool());
+    // Not toggled if the saved value is off
+    laser_detector->setSkipStaticFrames(_skip_static_frames_cb->isChecked());
+    QHBoxLayout* skip_static_frames_lo = new QHBoxLayout();
+    skip_static_frames_lo->addStretch();
+    skip_static_frames_lo->addWidget(skip_static_frames_lb);
+    skip_static_frames_lo->addWidget(_skip_static_frames_cb);
+
+    //// Streaming threshold ////
+    _streaming_threshold_cb = new QCheckBox();
+    QLabel* streaming_threshold_lb = new QLabel(tr("Streaming threshold:"));
+    streaming_threshold_lb->setToolTip(tr("Threshold frames by the brightness maximum of the\nprevious frame in one pass (with hotspots)."));
+    streaming_threshold_lb->setBuddy(_streaming_threshold_cb);
+    connect(_streaming_threshold_cb, &QCheckBox::toggled, laser_detector, &LaserDetector::setStreamingThreshold);
+    _streaming_threshold_cb->setChecked(settings.value("LaserDetectorCalibrationDialog/streaming_threshold", true).toBool());
+    // Not toggled if the saved value is off
+    laser_detector->setStreamingThreshold(_streaming_threshold_cb->isChecked());
+    QHBoxLayout* streaming_threshold_lo = new QHBoxLayout();
+    streaming_threshold_lo->addStretch();
+    streaming_threshold_lo->addWidget(streaming_threshold_lb);
+    streaming_threshold_lo->addWidget(_streaming_threshold_cb);
+
 
     ImageWidget* detected_blobs_img_wgt = new ImageWidget();
     connect(laser_detector, &LaserDetector::blobsAvailable, detected_blobs_img_wgt, &ImageWidget::setImage);
@@ -250,6 +330,11 @@ LaserDetectorCalibrationDialog::LaserDetectorCalibrationDialog(
     settings_lo->addLayout(blob_crown_margins_lo);
     settings_lo->addLayout(hue_lo);
     settings_lo->addLayout(blob_crown_valid_pixels_part_min_lo);
+    settings_lo->addLayout(luminance_only_lo);
+    settings_lo->addLayout(center_mode_lo);
+    settings_lo->addLayout(hotspot_lo);
+    settings_lo->addLayout(skip_static_frames_lo);
+    settings_lo->addLayout(streaming_threshold_lo);
     settings_lo->addStretch();
 
     QVBoxLayout* images_lo = new QVBoxLayout();
@@ -307,6 +392,11 @@ void LaserDetectorCalibrationDialog::emitBlobPerimeterRangeChanged() const
     emit blobPerimeterRangeChanged(min, max);
 }
 
+void LaserDetectorCalibrationDialog::emitCenterModeChanged() const
+{
+    emit centerModeChanged(static_cast<LaserDetector::CenterMode>(_center_mode_cb->currentData().toInt()));
+}
+
 void LaserDetectorCalibrationDialog::emitBlobCrownMarginsChanged() const
 {
     int min = _blob_crown_margin_inf_sb->value();
@@ -335,6 +425,12 @@ void LaserDetectorCalibrationDialog::writeSettings() const
     settings.setValue("hue_mean", _hue_mean_sb->value());
     settings.setValue("hue_span", _hue_span_sb->value());
     settings.setValue("blob_crown_valid_pixels_part_min", _blob_crown_valid_pixels_part_min_sb->value());
+    settings.setValue("luminance_only", _luminance_only_cb->isChecked());
+    settings.setValue("center_mode", _center_mode_cb->currentData());
+    settings.setValue("hotspot_learning", _hotspot_learning_cb->isChecked());
+    settings.setValue("skip_static_frames", _skip_static_frames_cb->isChecked());
+    settings.setValue("streaming_threshold", _streaming_threshold_cb->isChecked());
+    settings.setValue("hotspot_frame_map", _laser_detector->hotspotMap());
 
     settings.endGroup();
 }
@@ -3,13 +3,13 @@
 
 #include <QDialog>
 
+#include "laser_detector.h"
+
 class QSpinBox;
 class QDoubleSpinBox;
 class QLabel;
-
-namespace laser_painter {
-    class LaserDetector;
-}
+class QCheckBox;
+class QComboBox;
 
 namespace laser_painter {
 
@@ -30,6 +30,7 @@ signals:
     void blobClosingSizeChanged(uint min) const;
     void blobPerimeterRangeChanged(uint min, uint max) const;
     void blobCrownMarginsChanged(uint min, uint max) const;
+    void centerModeChanged(LaserDetector::CenterMode mode) const;
     void visible(bool visible) const;
 
 public slots:
@@ -40,6 +41,7 @@ private slots:
     void emitBlobClosingSizeChanged() const;
     void emitBlobPerimeterRangeChanged() const;
     void emitBlobCrownMarginsChanged() const;
+    void emitCenterModeChanged() const;
 
 private:
     inline void computeRange(int mean, int span, int& min, int& max) const;
@@ -56,6 +58,13 @@ private:
     QSpinBox* _hue_mean_sb;
     QSpinBox* _hue_span_sb;
     QDoubleSpinBox* _blob_crown_valid_pixels_part_min_sb;
+    QCheckBox* _luminance_only_cb;
+    QComboBox* _center_mode_cb;
+    QCheckBox* _hotspot_learning_cb;
+    QCheckBox* _skip_static_frames_cb;
+    QCheckBox* _streaming_threshold_cb;
+
+    LaserDetector* _laser_detector;
 };
 
 } // namespace laser_painter
@@ -3,10 +3,13 @@
 #include <QSettings>
 #include <QPushButton>
 #include <QDoubleSpinBox>
+#include <QComboBox>
+#include <QSpinBox>
 #include <QLabel>
 #include <QHBoxLayout>
 
 #include "laser_detector_calibration_dialog.h"
+#include "quality_governor.h"
 
 namespace laser_painter {
 
@@ -40,12 +43,92 @@ LaserDetectorSettings::LaserDetectorSettings(
     downscale_lo->addWidget(downscale_lb);
     downscale_lo->addWidget(_downscale_sb);
 
+    _downscale_mode_cb = new QComboBox();
+    _downscale_mode_cb->addItem(tr("Nearest"), ImageModifier::NearestScale);
+    _downscale_mode_cb->addItem(tr("Peak"), ImageModifier::PeakScale);
+    _downscale_mode_cb->addItem(tr("Area"), ImageModifier::AreaScale);
+    _downscale_mode_cb->setCurrentIndex(_downscale_mode_cb->findData(
+        settings.value("LaserDetectorSettings/downscale_mode", ImageModifier::PeakScale).toInt()));
+    connect(_downscale_mode_cb, SIGNAL(currentIndexChanged(int)), this, SLOT(emitScaleModeChanged()));
+    QLabel* downscale_mode_lb = new QLabel(tr("Downscale mode"));
+    downscale_mode_lb->setToolTip(tr("Nearest: keep one pixel of each block (fast,\nsmall dots can vanish at high downscales).\nPeak: keep the brightest pixel of each block.\nArea: mean of pixels of each block."));
+    downscale_mode_lb->setBuddy(_downscale_mode_cb);
+
+    QHBoxLayout* downscale_mode_lo = new QHBoxLayout();
+    downscale_mode_lo->addStretch();
+    downscale_mode_lo->addWidget(downscale_mode_lb);
+    downscale_mode_lo->addWidget(_downscale_mode_cb);
+
+    _idle_delay_sb = new QDoubleSpinBox();
+    _idle_delay_sb->setRange(0., 3600.);
+    _idle_delay_sb->setDecimals(0);
+    _idle_delay_sb->setSuffix(tr(" s"));
+    _idle_delay_sb->setSpecialValueText(tr("Never"));
+    _idle_delay_sb->setValue(settings.value("LaserDetectorSettings/idle_delay", 60.).toDouble());
+    connect(_idle_delay_sb, SIGNAL(valueChanged(double)), this, SLOT(emitIdleSettingsChanged()));
+    QLabel* idle_delay_lb = new QLabel(tr("Idle after"));
+    idle_delay_lb->setToolTip(tr("Reduce the detection rate when no laser dot\nwas detected for this time."));
+    idle_delay_lb->setBuddy(_idle_delay_sb);
+
+    _idle_frame_period_sb = new QSpinBox();
+    _idle_frame_period_sb->setRange(1, 60);
+    _idle_frame_period_sb->setPrefix(tr("1/"));
+    _idle_frame_period_sb->setValue(settings.value("LaserDetectorSettings/idle_frame_period", 4).toInt());
+    connect(_idle_frame_period_sb, SIGNAL(valueChanged(int)), this, SLOT(emitIdleSettingsChanged()));
+    QLabel* idle_frame_period_lb = new QLabel(tr("Idle rate"));
+    idle_frame_period_lb->setToolTip(tr("Part of the camera frames processed when idle."));
+    idle_frame_period_lb->setBuddy(_idle_frame_period_sb);
+
+    QHBoxLayout* idle_lo = new QHBoxLayout();
+    idle_lo->addStretch();
+    idle_lo->addWidget(idle_delay_lb);
+    idle_lo->addWidget(_idle_delay_sb);
+    idle_lo->addWidget(idle_frame_period_lb);
+    idle_lo->addWidget(_idle_frame_period_sb);
+
+    _latency_budget_sb = new QSpinBox();
+    _latency_budget_sb->setRange(0, 1000);
+    _latency_budget_sb->setSuffix(tr(" ms"));
+    _latency_budget_sb->setSpecialValueText(tr("Off"));
+    _latency_budget_sb->setValue(settings.value("LaserDetectorSettings/latency_budget", 16).toInt());
+    connect(_latency_budget_sb, SIGNAL(valueChanged(int)), this, SLOT(emitLatencyBudgetChanged()));
+    QLabel* latency_budget_lb = new QLabel(tr("Latency budget"));
+    latency_budget_lb->setToolTip(tr("Frame processing time to hold. The downscale\nis increased and the blob closing disabled\nwhen the detection is slower."));
+    latency_budget_lb->setBuddy(_latency_budget_sb);
+    _quality_level_lb = new QLabel();
+    showQualityLevel(0, 0.);
+
+    QHBoxLayout* latency_budget_lo = new QHBoxLayout();
+    latency_budget_lo->addStretch();
+    latency_budget_lo->addWidget(_quality_level_lb);
+    latency_budget_lo->addWidget(latency_budget_lb);
+    latency_budget_lo->addWidget(_latency_budget_sb);
+
+    _prediction_horizon_sb = new QSpinBox();
+    _prediction_horizon_sb->setRange(-1, 100);
+    _prediction_horizon_sb->setSuffix(tr(" ms"));
+    _prediction_horizon_sb->setSpecialValueText(tr("Off"));
+    _prediction_horizon_sb->setValue(settings.value("LaserDetectorSettings/prediction_horizon", 16).toInt());
+    connect(_prediction_horizon_sb, SIGNAL(valueChanged(int)), this, SLOT(emitPredictionHorizonChanged()));
+    QLabel* prediction_horizon_lb = new QLabel(tr("Prediction"));
+    prediction_horizon_lb->setToolTip(tr("Predict the laser dot position to compensate the\ndetection latency, plus this display latency."));
+    prediction_horizon_lb->setBuddy(_prediction_horizon_sb);
+
+    QHBoxLayout* prediction_horizon_lo = new QHBoxLayout();
+    prediction_horizon_lo->addStretch();
+    prediction_horizon_lo->addWidget(prediction_horizon_lb);
+    prediction_horizon_lo->addWidget(_prediction_horizon_sb);
+
     QHBoxLayout* calibration_lo = new QHBoxLayout();
     calibration_lo->addStretch();
     calibration_lo->addWidget(calibration_bn);
 
     QVBoxLayout* main_lo = new QVBoxLayout();
     main_lo->addLayout(downscale_lo);
+    main_lo->addLayout(downscale_mode_lo);
+    main_lo->addLayout(idle_lo);
+    main_lo->addLayout(latency_budget_lo);
+    main_lo->addLayout(prediction_horizon_lo);
     main_lo->addLayout(calibration_lo);
     setLayout(main_lo);
 }
@@ -57,6 +140,11 @@ void LaserDetectorSettings::writeSettings() const
     settings.beginGroup("LaserDetectorSettings");
 
     settings.setValue("downscale", _downscale_sb->value());
+    settings.setValue("downscale_mode", _downscale_mode_cb->currentData());
+    settings.setValue("idle_delay", _idle_delay_sb->value());
+    settings.setValue("idle_frame_period", _idle_frame_period_sb->value());
+    settings.setValue("latency_budget", _latency_budget_sb->value());
+    settings.setValue("prediction_horizon", _prediction_horizon_sb->value());
 
     settings.endGroup();
 }
@@ -78,4 +166,33 @@ void LaserDetectorSettings::emitScaleChanged() const
     emit scaleChanged(1. / scale);
 }
 
-} // namespace laser_painter
\ No newline at end of file
+void LaserDetectorSettings::emitScaleModeChanged() const
+{
+    emit scaleModeChanged(static_cast<ImageModifier::ScaleMode>(_downscale_mode_cb->currentData().toInt()));
+}
+
+void LaserDetectorSettings::emitIdleSettingsChanged() const
+{
+    emit idleFramePeriodChanged(_idle_frame_period_sb->value());
+    emit idleDelayChanged(_idle_delay_sb->value());
+}
+
+void LaserDetectorSettings::emitLatencyBudgetChanged() const
+{
+    emit latencyBudgetChanged(_latency_budget_sb->value());
+}
+
+void LaserDetectorSettings::emitPredictionHorizonChanged() const
+{
+    emit predictionHorizonChanged(_prediction_horizon_sb->value());
+}
+
+void LaserDetectorSettings::showQualityLevel(int level, qreal latency)
+{
+    _quality_level_lb->setText(tr("Quality %1/%2").arg(QualityGovernor::nbLevels() - level).arg(QualityGovernor::nbLevels()));
+    _quality_level_lb->setToolTip(level == 0 ?
+        tr("Full quality") :
+        tr("Quality reduced, frame processing time: %1 ms").arg(latency, 0, 'f', 1));
+}
+
+} // namespace laser_painter
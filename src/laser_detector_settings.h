@@ -3,7 +3,12 @@
 
 #include <QGroupBox>
 
+#include "image_modifier.h"
+
 class QDoubleSpinBox;
+class QComboBox;
+class QSpinBox;
+class QLabel;
 
 namespace laser_painter {
     class LaserDetectorCalibrationDialog;
@@ -26,11 +31,27 @@ public:
 signals:
     // scale <= 1.
     void scaleChanged(qreal scale) const;
+    void scaleModeChanged(ImageModifier::ScaleMode mode) const;
+    /// @see FrameThrottle
+    void idleDelayChanged(double delay) const;
+    void idleFramePeriodChanged(int period) const;
+    /// @see QualityGovernor
+    void latencyBudgetChanged(int budget) const;
+    /// @see PointPredictor
+    void predictionHorizonChanged(int horizon) const;
 
 public slots:
     // Emits a scaleChanged() signal with the current scale
     // HACK: make it public to resolve a connection after construcion problem
     void emitScaleChanged() const;
+    void emitScaleModeChanged() const;
+    void emitIdleSettingsChanged() const;
+    void emitLatencyBudgetChanged() const;
+    void emitPredictionHorizonChanged() const;
+
+    /// Show the quality level @param level and the frame processing time
+    /// @param latency (milliseconds) of the QualityGovernor.
+    void showQualityLevel(int level, qreal latency);
 
 private slots:
     void showFocusCalibraitionDialog() const;
@@ -38,6 +59,12 @@ private slots:
 private:
     LaserDetectorCalibrationDialog* _calibration_dg;
     QDoubleSpinBox* _downscale_sb;
+    QComboBox* _downscale_mode_cb;
+    QDoubleSpinBox* _idle_delay_sb;
+    QSpinBox* _idle_frame_period_sb;
+    QSpinBox* _latency_budget_sb;
+    QLabel* _quality_level_lb;
+    QSpinBox* _prediction_horizon_sb;
 };
 
 } // namespace laser_painter
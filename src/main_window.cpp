@@ -10,17 +10,30 @@
 #include <QDockWidget>
 #include <QVBoxLayout>
 #include <QStatusBar>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QDateTime>
+#include <QDir>
+#include <QInputDialog>
+#include <QThread>
 
 #include "video_frame_grabber.h"
 #include "camera_settings.h"
 #include "image_modifier.h"
+#include "frame_throttle.h"
+#include "quality_governor.h"
 #include "laser_detector.h"
 #include "point_modifier.h"
+#include "point_predictor.h"
 #include "laser_detector_settings.h"
 #include "laser_detector_calibration_dialog.h"
 #include "roi_image_widget.h"
 #include "track_widget.h"
 #include "tracker_settings.h"
+#include "stroke_log_writer.h"
+#include "stroke_log_player.h"
+#include "canvas_exporter.h"
 
 namespace laser_painter {
 
@@ -46,6 +59,29 @@ void MainWindow::createActions()
     _exit_act->setStatusTip(tr("Exit application"));
     connect(_exit_act,  &QAction::triggered, this, &MainWindow::close);
 
+    QSettings settings;
+
+    _record_strokes_act = new QAction(tr("&Record Strokes"), this);
+    _record_strokes_act->setCheckable(true);
+    _record_strokes_act->setChecked(settings.value("MainWindow/record_strokes", true).toBool());
+    _record_strokes_act->setStatusTip(tr("Record drawn strokes to a stroke log"));
+    connect(_record_strokes_act, &QAction::toggled, this, &MainWindow::toggleStrokeRecording);
+
+    _replay_strokes_act = new QAction(tr("Re&play Strokes..."), this);
+    _replay_strokes_act->setStatusTip(tr("Replay a stroke log at the recording speed"));
+    connect(_replay_strokes_act, &QAction::triggered, this, &MainWindow::replayStrokeLog);
+
+    _fast_replay_strokes_act = new QAction(tr("&Fast Replay Strokes..."), this);
+    _fast_replay_strokes_act->setStatusTip(tr("Replay a stroke log as fast as possible"));
+    connect(_fast_replay_strokes_act, &QAction::triggered, this, &MainWindow::fastReplayStrokeLog);
+
+    _stop_replay_act = new QAction(tr("&Stop Replay"), this);
+    _stop_replay_act->setEnabled(false);
+
+    _export_act = new QAction(tr("&Export Drawing..."), this);
+    _export_act->setStatusTip(tr("Export strokes of a stroke log into a high resolution image"));
+    connect(_export_act, &QAction::triggered, this, &MainWindow::exportDrawing);
+
     // Streams are the camera capture and the lasetr tracker
     QActionGroup* streams_gp = new QActionGroup(this);
     connect(streams_gp, &QActionGroup::triggered, this, &MainWindow::updateStreamsVisibility);
@@ -77,6 +113,12 @@ void MainWindow::createActions()
 void MainWindow::createMenus()
 {
     _file_mu = menuBar()->addMenu(tr("&File"));
+    _file_mu->addAction(_record_strokes_act);
+    _file_mu->addAction(_replay_strokes_act);
+    _file_mu->addAction(_fast_replay_strokes_act);
+    _file_mu->addAction(_stop_replay_act);
+    _file_mu->addAction(_export_act);
+    _file_mu->addSeparator();
     _file_mu->addAction(_exit_act);
 
     _view_mu = menuBar()->addMenu(tr("&View"));
@@ -103,27 +145,89 @@ void MainWindow::createWidgets()
     connect(video_frame_grabber, &VideoFrameGrabber::frameAvailable, _roi_image_wgt, &ROIImageWidget::setImage);
 
     ImageModifier* image_modifier = new ImageModifier(this);
-    connect(_roi_image_wgt, SIGNAL(roiChanged(const QRect&, const QSize&)), image_modifier, SLOT(setROI(const QRect&)));
-    connect(video_frame_grabber, &VideoFrameGrabber::frameAvailable, image_modifier, &ImageModifier::run);
+    connect(_roi_image_wgt, &ROIImageWidget::roiChanged, image_modifier, &ImageModifier::setROI);
+    // Reduce the detection rate when idle
+    FrameThrottle* frame_throttle = new FrameThrottle(this);
+    connect(video_frame_grabber, &VideoFrameGrabber::frameAvailable, frame_throttle, &FrameThrottle::run);
+    // Hold the frame processing time budget
+    QualityGovernor* quality_governor = new QualityGovernor(this);
+    connect(frame_throttle, &FrameThrottle::frameAvailable, quality_governor, &QualityGovernor::run);
+    connect(quality_governor, &QualityGovernor::frameAvailable, image_modifier, &ImageModifier::run);
+    connect(video_frame_grabber, &VideoFrameGrabber::frameScaleChanged, image_modifier, &ImageModifier::setFrameScale);
+    connect(_roi_image_wgt, &ROIImageWidget::maskChanged, image_modifier, &ImageModifier::setMask);
+    _roi_image_wgt->emitMaskChanged();
 
     LaserDetector* laser_detector = new LaserDetector(this);
     connect(image_modifier, &ImageModifier::imageAvailable, laser_detector, &LaserDetector::run);
+    connect(image_modifier, &ImageModifier::maskAvailable, laser_detector, &LaserDetector::setDetectionMask);
+    connect(image_modifier, &ImageModifier::geometryChanged, laser_detector, &LaserDetector::setFrameGeometry);
+    connect(quality_governor, &QualityGovernor::blobClosingEnabled, laser_detector, &LaserDetector::setBlobClosingEnabled);
 
     PointModifier* point_modifier = new PointModifier(this);
-    connect(_roi_image_wgt, SIGNAL(roiChanged(const QRect&, const QSize&)), point_modifier, SLOT(setROI(const QRect&)));
+    connect(_roi_image_wgt, &ROIImageWidget::roiChanged, point_modifier, &PointModifier::setROI);
     connect(laser_detector, &LaserDetector::laserPosition, point_modifier, &PointModifier::run);
+    connect(laser_detector, &LaserDetector::laserPosition, frame_throttle, &FrameThrottle::setLaserPosition);
+    connect(frame_throttle, &FrameThrottle::wokeUp, this, &MainWindow::showWakeUpLatency);
+    connect(video_frame_grabber, &VideoFrameGrabber::frameScaleChanged, point_modifier, &PointModifier::setFrameScale);
+
+    // Compensate the latency of points
+    _point_predictor = new PointPredictor(this);
+    connect(video_frame_grabber, &VideoFrameGrabber::frameCaptured, _point_predictor, &PointPredictor::setFrameTime);
+    connect(point_modifier, &PointModifier::pointAvailable, _point_predictor, &PointPredictor::run);
+
+    // Frames are not mirrored, only their preview and the detected points.
+    connect(_camera_settings, &CameraSettings::flipChanged, _roi_image_wgt, &ROIImageWidget::setFlip);
+    connect(_camera_settings, &CameraSettings::flipChanged, point_modifier, &PointModifier::setFlip);
+    _camera_settings->emitFlipChanged();
 
     _track_widget = new TrackWidget();
-    connect(point_modifier, SIGNAL(pointAvailable(const QPointF&, bool)), _track_widget, SLOT(addTip(const QPointF&, bool)));
+    connect(_point_predictor, &PointPredictor::pointAvailable, _track_widget, &TrackWidget::addTip);
     connect(_camera_settings, &CameraSettings::resolutionChanged, _track_widget, &TrackWidget::setCanvasSize);
     _track_widget->setCanvasSize(_camera_settings->currentResolution());
 
+    _stroke_log_writer = new StrokeLogWriter(this);
+    connect(_track_widget, &TrackWidget::tipAdded, _stroke_log_writer, &StrokeLogWriter::addTip);
+    connect(_track_widget, &TrackWidget::trackEnded, _stroke_log_writer, &StrokeLogWriter::endTrack);
+    connect(_camera_settings, &CameraSettings::resolutionChanged, _stroke_log_writer, &StrokeLogWriter::setCanvasSize);
+    toggleStrokeRecording(_record_strokes_act->isChecked());
+
+    _stroke_log_player = new StrokeLogPlayer(this);
+    connect(_stroke_log_player, SIGNAL(tipAvailable(const QPointF&, bool)), _track_widget, SLOT(addTip(const QPointF&, bool)));
+    connect(_stroke_log_player, &StrokeLogPlayer::trackEnded, _track_widget, &TrackWidget::startNewTrack);
+    connect(_stroke_log_player, &StrokeLogPlayer::canvasSizeChanged, _track_widget, &TrackWidget::setCanvasSize);
+    connect(_stroke_log_player, &StrokeLogPlayer::started, this, &MainWindow::replayStarted);
+    connect(_stroke_log_player, &StrokeLogPlayer::finished, this, &MainWindow::replayFinished);
+    connect(_stop_replay_act, &QAction::triggered, _stroke_log_player, &StrokeLogPlayer::stop);
+
+    // Export in a worker thread
+    _export_thread = new QThread(this);
+    _canvas_exporter = new CanvasExporter();
+    _canvas_exporter->moveToThread(_export_thread);
+    connect(_export_thread, &QThread::finished, _canvas_exporter, &QObject::deleteLater);
+    connect(this, &MainWindow::exportRequested, _canvas_exporter, &CanvasExporter::run);
+    connect(_canvas_exporter, &CanvasExporter::progress, this, &MainWindow::showExportProgress);
+    connect(_canvas_exporter, &CanvasExporter::finished, this, &MainWindow::exportFinished);
+    _export_thread->start(QThread::LowPriority);
+
     _laser_detector_calibration_dialog = new LaserDetectorCalibrationDialog(laser_detector, this);
 
     _laser_detector_settings = new LaserDetectorSettings(_laser_detector_calibration_dialog);
-    connect(_laser_detector_settings, &LaserDetectorSettings::scaleChanged, image_modifier, &ImageModifier::setScale);
-    connect(_laser_detector_settings, &LaserDetectorSettings::scaleChanged, point_modifier, &PointModifier::setUnscale);
+    // The governor lowers the scale set by the user when frames are slow.
+    connect(quality_governor, &QualityGovernor::scaleChanged, image_modifier, &ImageModifier::setScale);
+    connect(quality_governor, &QualityGovernor::scaleChanged, point_modifier, &PointModifier::setUnscale);
+    connect(quality_governor, &QualityGovernor::scaleChanged, video_frame_grabber, &VideoFrameGrabber::setDecodeScale);
+    connect(quality_governor, &QualityGovernor::levelChanged, _laser_detector_settings, &LaserDetectorSettings::showQualityLevel);
+    connect(_laser_detector_settings, &LaserDetectorSettings::scaleChanged, quality_governor, &QualityGovernor::setBaseScale);
     _laser_detector_settings->emitScaleChanged();
+    connect(_laser_detector_settings, &LaserDetectorSettings::latencyBudgetChanged, quality_governor, &QualityGovernor::setLatencyBudget);
+    _laser_detector_settings->emitLatencyBudgetChanged();
+    connect(_laser_detector_settings, &LaserDetectorSettings::predictionHorizonChanged, _point_predictor, &PointPredictor::setHorizon);
+    _laser_detector_settings->emitPredictionHorizonChanged();
+    connect(_laser_detector_settings, &LaserDetectorSettings::scaleModeChanged, image_modifier, &ImageModifier::setScaleMode);
+    _laser_detector_settings->emitScaleModeChanged();
+    connect(_laser_detector_settings, &LaserDetectorSettings::idleDelayChanged, frame_throttle, &FrameThrottle::setIdleDelay);
+    connect(_laser_detector_settings, &LaserDetectorSettings::idleFramePeriodChanged, frame_throttle, &FrameThrottle::setIdleFramePeriod);
+    _laser_detector_settings->emitIdleSettingsChanged();
 
     _tracker_settings = new TrackerSettings(_track_widget);
 
@@ -153,6 +257,9 @@ void MainWindow::createWidgets()
     setStatusBar(new QStatusBar());
     connect(video_frame_grabber, &VideoFrameGrabber::warning, this, &MainWindow::showWarning);
     connect(laser_detector, &LaserDetector::warning, this, &MainWindow::showWarning);
+    connect(_stroke_log_writer, &StrokeLogWriter::warning, this, &MainWindow::showWarning);
+    connect(_stroke_log_player, &StrokeLogPlayer::warning, this, &MainWindow::showWarning);
+    connect(_canvas_exporter, &CanvasExporter::warning, this, &MainWindow::showWarning);
 }
 
 void MainWindow::updateStreamsVisibility(QAction* stream_act)
@@ -188,6 +295,117 @@ void MainWindow::toggleFullScreen(bool enable)
     }
 }
 
+void MainWindow::toggleStrokeRecording(bool enabled)
+{
+    if(!enabled) {
+        _stroke_log_writer->close();
+        return;
+    }
+
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/strokes";
+    QString name = QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss") + ".lpsl";
+    _stroke_log_writer->open(QDir(dir).filePath(name), _camera_settings->currentResolution());
+}
+
+void MainWindow::replayStrokeLog()
+{
+    QString path = QFileDialog::getOpenFileName(
+        this, tr("Replay Strokes"),
+        QFileInfo(_stroke_log_writer->path()).absolutePath(),
+        tr("Stroke logs (*.lpsl)")
+    );
+    if(!path.isEmpty())
+        _stroke_log_player->play(path);
+}
+
+void MainWindow::fastReplayStrokeLog()
+{
+    QString path = QFileDialog::getOpenFileName(
+        this, tr("Fast Replay Strokes"),
+        QFileInfo(_stroke_log_writer->path()).absolutePath(),
+        tr("Stroke logs (*.lpsl)")
+    );
+    if(!path.isEmpty())
+        _stroke_log_player->play(path, true);
+}
+
+void MainWindow::replayStarted()
+{
+    // Live points would be drawn into the replayed strokes.
+    disconnect(_point_predictor, &PointPredictor::pointAvailable, _track_widget, &TrackWidget::addTip);
+    _track_widget->startNewTrack();
+    // Don't record the replayed strokes
+    _stroke_log_writer->flush();
+    _stroke_log_writer->setRecording(false);
+    _stop_replay_act->setEnabled(true);
+}
+
+void MainWindow::replayFinished()
+{
+    _track_widget->startNewTrack();
+    _track_widget->setCanvasSize(_camera_settings->currentResolution());
+    _stroke_log_writer->setRecording(true);
+    connect(_point_predictor, &PointPredictor::pointAvailable, _track_widget, &TrackWidget::addTip, Qt::UniqueConnection);
+    _stop_replay_act->setEnabled(false);
+}
+
+void MainWindow::exportDrawing()
+{
+    QString log_path = QFileDialog::getOpenFileName(
+        this, tr("Export Drawing: Stroke Log"),
+        _stroke_log_writer->path(),
+        tr("Stroke logs (*.lpsl)")
+    );
+    if(log_path.isEmpty())
+        return;
+
+    QString image_path = QFileDialog::getSaveFileName(
+        this, tr("Export Drawing: Image"),
+        QFileInfo(log_path).absoluteDir().filePath(QFileInfo(log_path).completeBaseName() + ".tif"),
+        tr("TIFF images (*.tif *.tiff)")
+    );
+    if(image_path.isEmpty())
+        return;
+
+    bool ok;
+    int width = QInputDialog::getInt(
+        this, tr("Export Drawing"), tr("Image width:"),
+        16384, 16, 65535, 1, &ok
+    );
+    if(!ok)
+        return;
+
+    // Make the current log complete before the exporter thread reads it
+    _stroke_log_writer->sync();
+
+    _export_act->setEnabled(false);
+    emit exportRequested(
+        log_path, image_path, width,
+        _track_widget->trackColor(), _track_widget->trackWidth(), _track_widget->canvasColor()
+    );
+}
+
+void MainWindow::showExportProgress(int percent)
+{
+    statusBar()->setStyleSheet(QString());
+    statusBar()->showMessage(tr("Exporting drawing: %1%").arg(percent));
+}
+
+void MainWindow::exportFinished(bool success)
+{
+    _export_act->setEnabled(true);
+    if(success) {
+        statusBar()->setStyleSheet(QString());
+        statusBar()->showMessage(tr("Drawing exported"), 5000);
+    }
+}
+
+void MainWindow::showWakeUpLatency(int latency)
+{
+    statusBar()->setStyleSheet(QString());
+    statusBar()->showMessage(tr("Laser detected, wake-up latency: %1 ms").arg(latency), 5000);
+}
+
 void MainWindow::showWarning(const QString& text)
 {
     Q_ASSERT(statusBar());
@@ -200,6 +418,7 @@ void MainWindow::writeSettings()
     QSettings settings;
 
     _camera_settings->writeSettings();
+    _roi_image_wgt->writeSettings();
     _laser_detector_settings->writeSettings();
     _laser_detector_calibration_dialog->writeSettings();
     _tracker_settings->writeSettings();
@@ -207,6 +426,7 @@ void MainWindow::writeSettings()
     settings.beginGroup("MainWindow");
 
     settings.setValue("window_size", size());
+    settings.setValue("record_strokes", _record_strokes_act->isChecked());
 
     settings.endGroup();
 }
@@ -214,6 +434,11 @@ void MainWindow::writeSettings()
 void MainWindow::closeEvent(QCloseEvent *event)
 {
     writeSettings();
+    _stroke_log_player->stop();
+    _stroke_log_writer->close();
+    _export_thread->requestInterruption();
+    _export_thread->quit();
+    _export_thread->wait();
     QMainWindow::closeEvent(event);
     _laser_detector_calibration_dialog->deleteLater();
 }
@@ -2,10 +2,12 @@
 #define MAIN_WINDOW_H
 
 #include <QMainWindow>
+#include <QColor>
 
 class QAction;
 class QMenu;
 class QDockWidget;
+class QThread;
 
 namespace laser_painter {
     class ROIImageWidget;
@@ -14,6 +16,10 @@ namespace laser_painter {
     class CameraSettings;
     class TrackWidget;
     class TrackerSettings;
+    class StrokeLogWriter;
+    class StrokeLogPlayer;
+    class CanvasExporter;
+    class PointPredictor;
 }
 
 namespace laser_painter {
@@ -25,6 +31,16 @@ class MainWindow : public QMainWindow
 public:
     MainWindow(QWidget *parent = 0, Qt::WindowFlags flags = 0);
 
+signals:
+    void exportRequested(
+        const QString& log_path,
+        const QString& image_path,
+        int width,
+        const QColor& track_color,
+        int track_width,
+        const QColor& canvas_color
+    ) const;
+
 protected:
     void closeEvent(QCloseEvent *event);
 
@@ -36,9 +52,19 @@ private:
     void writeSettings();
 
 private slots:
+    // Start a new stroke log if recording is @param enabled.
+    void toggleStrokeRecording(bool enabled);
+    void replayStrokeLog();
+    void fastReplayStrokeLog();
+    void replayStarted();
+    void replayFinished();
+    void exportDrawing();
+    void showExportProgress(int percent);
+    void exportFinished(bool success);
     void updateStreamsVisibility(QAction* stream_act);
     void toggleFullScreen(bool enable = false);
     void showWarning(const QString& text);
+    void showWakeUpLatency(int latency);
 
 private:
     QAction* _exit_act;
@@ -47,6 +73,11 @@ private:
     QAction* _laser_tracker_act;
     QAction* _camera_tracker_act;
     QAction* _full_screen_act;
+    QAction* _record_strokes_act;
+    QAction* _replay_strokes_act;
+    QAction* _fast_replay_strokes_act;
+    QAction* _stop_replay_act;
+    QAction* _export_act;
     QMenu* _file_mu;
     QMenu* _view_mu;
     ROIImageWidget* _roi_image_wgt;
@@ -54,7 +85,12 @@ private:
     TrackerSettings* _tracker_settings;
     LaserDetectorCalibrationDialog* _laser_detector_calibration_dialog;
     CameraSettings* _camera_settings;
+    PointPredictor* _point_predictor;
     TrackWidget* _track_widget;
+    StrokeLogWriter* _stroke_log_writer;
+    StrokeLogPlayer* _stroke_log_player;
+    QThread* _export_thread;
+    CanvasExporter* _canvas_exporter;
     QDockWidget* _settings_dk;
 };
 
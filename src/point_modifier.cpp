@@ -7,27 +7,45 @@ namespace laser_painter {
 PointModifier::PointModifier(QObject* parent)
     : QObject(parent),
     _roi(),
-    _unscale(1.)
+    _frame_size(),
+    _flip_x(false),
+    _flip_y(false),
+    _unscale(1.),
+    _frame_scale(1.)
 {}
 
 void PointModifier::run(const QPointF& point, bool found) const
 {
     Q_ASSERT(_unscale > 0);
 
-    if(!found)
+    if(!found) {
         emit pointAvailable(point, found);
+        return;
+    }
 
+    // The ImageModifier scaled the region of interest of grabbed frames by
+    // min(_unscale / _frame_scale, 1).
     QPointF result = point;
-    if(_unscale != 1.)
-        result /= _unscale;
+    qreal unscale = qMin(_unscale / _frame_scale, 1.);
+    if(unscale != 1.)
+        result /= unscale;
     result += _roi.topLeft();
+    // Frames are not mirrored, pixel i becomes size - 1 - i.
+    if(_flip_x)
+        result.setX(_frame_size.width() - 1 - result.x());
+    if(_flip_y)
+        result.setY(_frame_size.height() - 1 - result.y());
+    // Back to the camera resolution
+    if(_frame_scale != 1.)
+        result /= _frame_scale;
 
     emit pointAvailable(result, found);
 }
 
-void PointModifier::setROI(const QRect& roi)
+void PointModifier::setROI(const QRect& roi, const QSize& frame_size)
 {
     _roi = roi;
+    _frame_size = frame_size;
 }
 
 void PointModifier::setUnscale(qreal unscale)
@@ -35,4 +53,16 @@ void PointModifier::setUnscale(qreal unscale)
     _unscale = unscale;
 }
 
+void PointModifier::setFlip(bool flip_x, bool flip_y)
+{
+    _flip_x = flip_x;
+    _flip_y = flip_y;
+}
+
+void PointModifier::setFrameScale(qreal scale)
+{
+    Q_ASSERT(scale > 0);
+    _frame_scale = scale;
+}
+
 } // namespace laser_painter
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <QObject>
 #include <QRect>
+#include <QSize>
 
 class QPoint;
 
@@ -18,9 +19,15 @@ public:
 
 public slots:
     void run(const QPointF& point, bool found) const;
-    /// Set (non-scaled) region of interest
-    void setROI(const QRect& roi);
+    /// Set (non-scaled) region of interest @param roi of grabbed frames of
+    /// size @param frame_size, in the coordinate system of the grabbed frames
+    void setROI(const QRect& roi, const QSize& frame_size);
     void setUnscale(qreal unscale);
+    /// @see ImageModifier::setFrameScale()
+    void setFrameScale(qreal scale);
+    /// Flip points horizontally if @param flip_x and vertically if
+    /// @param flip_y (in the grabbed frame).
+    void setFlip(bool flip_x, bool flip_y);
 
 signals:
     /// Transformed point available
@@ -28,7 +35,11 @@ signals:
 
 private:
     QRect _roi;
+    QSize _frame_size;
+    bool _flip_x;
+    bool _flip_y;
     qreal _unscale;
+    qreal _frame_scale;
 };
 
 } // namespace laser_painter
@@ -0,0 +1,103 @@
+#include "point_predictor.h"
+
+#include <QPointF>
+
+namespace laser_painter {
+
+const qreal PointPredictor::_acceleration_variance = 4e6;
+const qreal PointPredictor::_position_variance = 4.;
+
+PointPredictor::PointPredictor(QObject* parent)
+    : QObject(parent),
+    _horizon(0),
+    _frame_time(-1),
+    _last_time(0),
+    _has_track(false)
+{
+    _clock.start();
+}
+
+void PointPredictor::run(const QPointF& point, bool found)
+{
+    if(!found || _horizon < 0) {
+        reset();
+        emit pointAvailable(point, found);
+        return;
+    }
+
+    const qint64 now = _clock.msecsSinceReference() + _clock.elapsed();
+    // Without frame times, points are timed at their arrival.
+    const qint64 time = _frame_time < 0 ? now : _frame_time;
+
+    if(!_has_track || time - _last_time > _max_gap || time < _last_time) {
+        _x.reset(point.x());
+        _y.reset(point.y());
+        _has_track = true;
+    } else {
+        const qreal dt = (time - _last_time) / 1000.;
+        _x.predict(dt, _acceleration_variance);
+        _y.predict(dt, _acceleration_variance);
+        _x.update(point.x(), _position_variance);
+        _y.update(point.y(), _position_variance);
+    }
+    _last_time = time;
+
+    // Extrapolate to the display time
+    const qreal dt = qMin(now - time + _horizon, qint64(_max_extrapolation)) / 1000.;
+    emit pointAvailable(
+        QPointF(_x.position + _x.velocity * dt, _y.position + _y.velocity * dt),
+        found
+    );
+}
+
+void PointPredictor::setFrameTime(qint64 time)
+{
+    _frame_time = time;
+}
+
+void PointPredictor::setHorizon(int horizon)
+{
+    _horizon = horizon;
+    reset();
+}
+
+void PointPredictor::reset()
+{
+    _has_track = false;
+}
+
+void PointPredictor::Axis::reset(qreal position)
+{
+    this->position = position;
+    velocity = 0.;
+    // Unknown velocity
+    p00 = _position_variance;
+    p01 = 0.;
+    p11 = 1e6;
+}
+
+void PointPredictor::Axis::predict(qreal dt, qreal acceleration_variance)
+{
+    position += velocity * dt;
+    // P = F P F' + Q, F = [1 dt; 0 1], Q of a white noise acceleration
+    const qreal dt2 = dt * dt;
+    p00 += dt * (2. * p01 + dt * p11) + acceleration_variance * dt2 * dt2 / 4.;
+    p01 += dt * p11 + acceleration_variance * dt2 * dt / 2.;
+    p11 += acceleration_variance * dt2;
+}
+
+void PointPredictor::Axis::update(qreal position, qreal position_variance)
+{
+    const qreal s = p00 + position_variance;
+    const qreal k0 = p00 / s;
+    const qreal k1 = p01 / s;
+    const qreal innovation = position - this->position;
+    this->position += k0 * innovation;
+    velocity += k1 * innovation;
+    // P = (I - K H) P
+    p11 -= k1 * p01;
+    p01 -= k0 * p01;
+    p00 -= k0 * p00;
+}
+
+} // namespace laser_painter
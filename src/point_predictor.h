@@ -0,0 +1,76 @@
+#ifndef POINT_PREDICTOR
+#define POINT_PREDICTOR
+
+#include <QObject>
+#include <QElapsedTimer>
+
+class QPointF;
+
+namespace laser_painter {
+
+/// Compensate the capture and processing latency of detected points:
+/// filter them by a constant velocity Kalman filter and extrapolate them
+/// to the expected display time.
+class PointPredictor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PointPredictor(QObject* parent = 0);
+
+public slots:
+    void run(const QPointF& point, bool found);
+    /// The next points are detected in a frame captured at @param time
+    /// (QElapsedTimer::msecsSinceReference()).
+    void setFrameTime(qint64 time);
+    /// Extrapolate points @param horizon milliseconds after the end of
+    /// their processing (display latency). If negative, points are passed
+    /// unchanged.
+    void setHorizon(int horizon);
+
+signals:
+    /// Predicted point available
+    void pointAvailable(const QPointF& point, bool found) const;
+
+private:
+    // Kalman filter of one coordinate, state (position, velocity)
+    struct Axis {
+        void reset(qreal position);
+        // Predict the state @param dt seconds later, with the acceleration
+        // variance @param acceleration_variance.
+        void predict(qreal dt, qreal acceleration_variance);
+        // Correct the state by the measured @param position of the variance
+        // @param position_variance.
+        void update(qreal position, qreal position_variance);
+
+        qreal position;
+        qreal velocity;
+        // Covariance of the state
+        qreal p00, p01, p11;
+    };
+
+    void reset();
+
+private:
+    int _horizon; // milliseconds
+    qint64 _frame_time;
+    qint64 _last_time;
+    bool _has_track;
+    Axis _x;
+    Axis _y;
+    // Reference time of _clock start, see QElapsedTimer::msecsSinceReference()
+    QElapsedTimer _clock;
+
+    // Track is restarted after this gap between points (milliseconds)
+    static const int _max_gap = 200;
+    // Extrapolation is limited to this time (milliseconds)
+    static const int _max_extrapolation = 100;
+    // Variances of the dot acceleration (px^2/s^4) and of the detected
+    // position (px^2)
+    static const qreal _acceleration_variance;
+    static const qreal _position_variance;
+};
+
+} // namespace laser_painter
+
+#endif // POINT_PREDICTOR
@@ -0,0 +1,110 @@
+#include "quality_governor.h"
+
+#include <QImage>
+
+namespace laser_painter {
+
+namespace {
+
+// Quality levels
+struct QualityLevel {
+    // Downscale relatively to the base scale
+    qreal downscale;
+    bool blob_closing;
+};
+
+const QualityLevel quality_levels[] = {
+    {1., true},
+    {1.5, true},
+    {2., true},
+    {2., false},
+    {3., false},
+    {4., false}
+};
+
+} // namespace
+
+const qreal QualityGovernor::_latency_average_weight = 0.1;
+const qreal QualityGovernor::_latency_low_part = 0.6;
+
+QualityGovernor::QualityGovernor(QObject* parent)
+    : QObject(parent),
+    _base_scale(1.),
+    _latency_budget(0),
+    _level(0),
+    _latency_average(0.),
+    _nb_frames_since_change(0),
+    _nb_fast_frames(0)
+{}
+
+int QualityGovernor::nbLevels()
+{
+    return sizeof(quality_levels) / sizeof(quality_levels[0]);
+}
+
+void QualityGovernor::run(const QImage& frame)
+{
+    _timer.start();
+    emit frameAvailable(frame);
+    const qreal latency = _timer.nsecsElapsed() / 1e6;
+
+    if(_latency_budget == 0)
+        return;
+
+    _latency_average = _nb_frames_since_change == 0 ?
+        latency :
+        _latency_average_weight * latency + (1. - _latency_average_weight) * _latency_average;
+    ++_nb_frames_since_change;
+    if(_nb_frames_since_change < _nb_settle_frames)
+        return;
+
+    // Changes take effect from the next frame, all parameters at once.
+    if(_latency_average > _latency_budget) {
+        _nb_fast_frames = 0;
+        if(_level + 1 < nbLevels())
+            setLevel(_level + 1);
+    } else if(_latency_average < _latency_low_part * _latency_budget) {
+        if(++_nb_fast_frames >= _nb_fast_frames_min && _level > 0)
+            setLevel(_level - 1);
+    } else
+        _nb_fast_frames = 0;
+}
+
+void QualityGovernor::setBaseScale(qreal scale)
+{
+    Q_ASSERT(scale > 0 && scale <= 1.);
+
+    _base_scale = scale;
+    applyLevel();
+}
+
+void QualityGovernor::setLatencyBudget(int budget)
+{
+    Q_ASSERT(budget >= 0);
+
+    _latency_budget = budget;
+    if(_latency_budget == 0)
+        setLevel(0);
+}
+
+void QualityGovernor::setLevel(int level)
+{
+    Q_ASSERT(level >= 0 && level < nbLevels());
+
+    _nb_frames_since_change = 0;
+    _nb_fast_frames = 0;
+    if(level == _level)
+        return;
+    _level = level;
+    applyLevel();
+}
+
+void QualityGovernor::applyLevel()
+{
+    const QualityLevel& level = quality_levels[_level];
+    emit scaleChanged(_base_scale / level.downscale);
+    emit blobClosingEnabled(level.blob_closing);
+    emit levelChanged(_level, _latency_average);
+}
+
+} // namespace laser_painter
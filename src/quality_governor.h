@@ -0,0 +1,72 @@
+#ifndef QUALITY_GOVERNOR
+#define QUALITY_GOVERNOR
+
+#include <QObject>
+#include <QElapsedTimer>
+
+class QImage;
+
+namespace laser_painter {
+
+/// Keep the frame processing time under a latency budget by lowering the
+/// detection quality (higher downscale, no blob closing) when frames are
+/// too slow, and raising it back when there's enough headroom.
+/// Frames pass through the governor, their processing is synchronous.
+class QualityGovernor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QualityGovernor(QObject* parent = 0);
+
+    /// Number of quality levels, 0 is the best quality.
+    static int nbLevels();
+
+public slots:
+    /// Pass the frame @param frame and measure its processing time.
+    void run(const QImage& frame);
+
+    /// Set the scale @param scale (<= 1) of the best quality level.
+    void setBaseScale(qreal scale);
+    /// Set the frame processing time budget to @param budget milliseconds.
+    /// If zero, the quality isn't adjusted (level 0).
+    void setLatencyBudget(int budget);
+
+signals:
+    void frameAvailable(const QImage& frame) const;
+    /// Detection scale (<= 1) is changed to @param scale.
+    void scaleChanged(qreal scale) const;
+    void blobClosingEnabled(bool enabled) const;
+    /// Quality level is changed to @param level, with the frame processing
+    /// time average @param latency (milliseconds).
+    void levelChanged(int level, qreal latency) const;
+
+private:
+    void setLevel(int level);
+    // Emit parameters of the current level.
+    void applyLevel();
+
+private:
+    qreal _base_scale;
+    int _latency_budget; // milliseconds
+    int _level;
+    // Exponential moving average of the frame processing time
+    qreal _latency_average; // milliseconds
+    // Frames since the last level change and with a low latency
+    int _nb_frames_since_change;
+    int _nb_fast_frames;
+    QElapsedTimer _timer;
+
+    // Weight of the last frame in the latency average
+    static const qreal _latency_average_weight;
+    // The quality is raised when the average latency stays below this part
+    // of the budget for _nb_fast_frames_min frames (hysteresis).
+    static const qreal _latency_low_part;
+    static const int _nb_fast_frames_min = 60;
+    // Frames to wait after a level change before the next change
+    static const int _nb_settle_frames = 15;
+};
+
+} // namespace laser_painter
+
+#endif // QUALITY_GOVERNOR
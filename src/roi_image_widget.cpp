@@ -2,19 +2,55 @@
 
 #include <QRubberBand>
 #include <QMouseEvent>
+#include <QKeyEvent>
+#include <QPainter>
+#include <QSettings>
+#include <QVariant>
 
 namespace laser_painter {
 
 ROIImageWidget::ROIImageWidget(QWidget* parent, Qt::WindowFlags f)
     : ImageWidget(parent, f),
     _selection_origin(),
-    _selection(new QRubberBand(QRubberBand::Rectangle, this))
+    _selection(new QRubberBand(QRubberBand::Rectangle, this)),
+    _mask_polygon_excluded(false),
+    _editing_mask(false)
 {
     selectEntireImage();
     QPalette palette;
     palette.setBrush(QPalette::Highlight, QBrush(Qt::magenta));
     _selection->setPalette(palette);
     _selection->show();
+    // Keys edit the selection and the mask
+    setFocusPolicy(Qt::ClickFocus);
+
+    QSettings settings;
+    foreach(const QVariant& polygon, settings.value("ROIImageWidget/mask_include").toList())
+        _mask_include.append(polygon.value<QPolygonF>());
+    foreach(const QVariant& polygon, settings.value("ROIImageWidget/mask_exclude").toList())
+        _mask_exclude.append(polygon.value<QPolygonF>());
+}
+
+void ROIImageWidget::writeSettings() const
+{
+    QSettings settings;
+
+    settings.beginGroup("ROIImageWidget");
+
+    QVariantList include, exclude;
+    foreach(const QPolygonF& polygon, _mask_include)
+        include.append(QVariant::fromValue(polygon));
+    foreach(const QPolygonF& polygon, _mask_exclude)
+        exclude.append(QVariant::fromValue(polygon));
+    settings.setValue("mask_include", include);
+    settings.setValue("mask_exclude", exclude);
+
+    settings.endGroup();
+}
+
+void ROIImageWidget::emitMaskChanged() const
+{
+    emit maskChanged(_mask_include, _mask_exclude);
 }
 
 void ROIImageWidget::setImage(const QImage& image)
@@ -34,14 +70,34 @@ void ROIImageWidget::setImage(const QImage& image)
         updateSelectionFromROI();
 }
 
+void ROIImageWidget::setFlip(bool flip_x, bool flip_y)
+{
+    ImageWidget::setFlip(flip_x, flip_y);
+    // The roi is kept, its selection is mirrored.
+    updateSelectionFromROI();
+}
+
 void ROIImageWidget::mousePressEvent(QMouseEvent *event)
 {
+    _editing_mask = event->modifiers() & (Qt::ShiftModifier | Qt::ControlModifier);
+    if(_editing_mask) {
+        if(_image.isNull() || !QRect(_image_origin, _image.size()).contains(event->pos()))
+            return;
+        if(_mask_polygon.isEmpty())
+            _mask_polygon_excluded = event->modifiers() & Qt::ControlModifier;
+        _mask_polygon.append(fromWidget(event->pos()));
+        update();
+        return;
+    }
+
     _selection_origin = event->pos();
     _selection->setGeometry(QRect(_selection_origin, QSize()));
 }
 
 void ROIImageWidget::mouseMoveEvent(QMouseEvent *event)
 {
+    if(_editing_mask)
+        return;
     _selection->setGeometry(
         QRect(_selection_origin, event->pos())
         .intersected(QRect(_image_origin, _image.size()))
@@ -51,6 +107,8 @@ void ROIImageWidget::mouseMoveEvent(QMouseEvent *event)
 
 void ROIImageWidget::mouseReleaseEvent(QMouseEvent *event)
 {
+    if(_editing_mask)
+        return;
     if(_image.isNull())
         return;
 
@@ -62,8 +120,74 @@ void ROIImageWidget::mouseReleaseEvent(QMouseEvent *event)
 
 void ROIImageWidget::keyPressEvent(QKeyEvent *event)
 {
-    if(event->key() == Qt::Key_Escape || event->key() == Qt::Key_Space)
+    switch(event->key()) {
+    case Qt::Key_Escape:
+    case Qt::Key_Space:
         selectEntireImage();
+        break;
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+        // Finish the edited polygon
+        if(_mask_polygon.size() >= 3) {
+            (_mask_polygon_excluded ? _mask_exclude : _mask_include).append(_mask_polygon);
+            emitMaskChanged();
+        }
+        _mask_polygon.clear();
+        update();
+        break;
+    case Qt::Key_Backspace:
+        if(!_mask_polygon.isEmpty())
+            _mask_polygon.removeLast();
+        update();
+        break;
+    case Qt::Key_Delete:
+        _mask_polygon.clear();
+        _mask_include.clear();
+        _mask_exclude.clear();
+        emitMaskChanged();
+        update();
+        break;
+    default:
+        ImageWidget::keyPressEvent(event);
+    }
+}
+
+void ROIImageWidget::paintEvent(QPaintEvent* event)
+{
+    ImageWidget::paintEvent(event);
+
+    if(_image.isNull() || (_mask_include.isEmpty() && _mask_exclude.isEmpty() && _mask_polygon.isEmpty()))
+        return;
+
+    // Mask overlay
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing);
+    const QColor include_color(Qt::green);
+    const QColor exclude_color(Qt::red);
+    QColor fill_color;
+    for(int k = 0; k < 2; ++k) {
+        const QVector<QPolygonF>& polygons = k == 0 ? _mask_include : _mask_exclude;
+        fill_color = k == 0 ? include_color : exclude_color;
+        painter.setPen(fill_color);
+        fill_color.setAlpha(48);
+        painter.setBrush(fill_color);
+        foreach(const QPolygonF& polygon, polygons) {
+            QPolygonF widget_polygon;
+            foreach(const QPointF& point, polygon)
+                widget_polygon.append(toWidget(point));
+            painter.drawPolygon(widget_polygon);
+        }
+    }
+    if(!_mask_polygon.isEmpty()) {
+        QPolygonF widget_polygon;
+        foreach(const QPointF& point, _mask_polygon)
+            widget_polygon.append(toWidget(point));
+        painter.setPen(QPen(_mask_polygon_excluded ? exclude_color : include_color, 1, Qt::DashLine));
+        painter.setBrush(Qt::NoBrush);
+        painter.drawPolyline(widget_polygon);
+        foreach(const QPointF& point, widget_polygon)
+            painter.drawEllipse(point, 2, 2);
+    }
 }
 
 void ROIImageWidget::selectEntireImage(bool update_roi)
@@ -75,17 +199,20 @@ void ROIImageWidget::selectEntireImage(bool update_roi)
 
 void ROIImageWidget::updateInputGeometry(const QSize& input_image_size)
 {
-    if(_image.isNull() || _roi.size() == _input_image_size)
-        // Set roi to 0 if the new image is invlaid
+    if(_input_image_size.isEmpty() || _roi.size() == _input_image_size)
+        // Set roi to 0 if there was no valid input image
         // OR entire input image remains roi.
         _roi = QRect(QPoint(), input_image_size);
     else {
-        qreal scale_x = static_cast<qreal>(input_image_size.width()) / _image.width();
-        qreal scale_y = static_cast<qreal>(input_image_size.height()) / _image.height();
+        // Same region in the new input image (another resolution or decode
+        // scale)
+        qreal scale_x = static_cast<qreal>(input_image_size.width()) / _input_image_size.width();
+        qreal scale_y = static_cast<qreal>(input_image_size.height()) / _input_image_size.height();
+        // Round the edges: the roi doesn't drift when the size changes back.
         _roi = QRect(
-            QPoint(_roi.left() * scale_x, _roi.top() * scale_y),
-            QSize(_roi.width() * scale_x, _roi.height() * scale_y)
-        );
+            QPoint(qRound(_roi.left() * scale_x), qRound(_roi.top() * scale_y)),
+            QPoint(qRound((_roi.right() + 1) * scale_x) - 1, qRound((_roi.bottom() + 1) * scale_y) - 1)
+        ) & QRect(QPoint(), input_image_size);
     }
     _input_image_size = input_image_size;
     emit roiChanged(_roi, _input_image_size);
@@ -100,10 +227,12 @@ void ROIImageWidget::updateSelectionFromROI()
 
     // scale_x = scale_y because _image keeps the input image aspect ratio.
     qreal scale = static_cast<qreal>(_image.width()) / _input_image_size.width();
-    QPoint selection_origin = _image_origin + _roi.topLeft() * scale;
+    // Roi as shown
+    QRect roi = flipped(_roi);
+    QPoint selection_origin = _image_origin + roi.topLeft() * scale;
     QSize selection_size(
-        _roi.width() * scale,
-        _roi.height() * scale
+        roi.width() * scale,
+        roi.height() * scale
     );
     _selection->setGeometry(QRect(selection_origin, selection_size)
         .intersected(QRect(_image_origin, _image.size())));
@@ -121,12 +250,42 @@ void ROIImageWidget::updateROIFromSelection()
             _selection->width() * unscale,
             _selection->height() * unscale
         );
-        _roi = QRect(roi_origin, roi_size)
+        _roi = flipped(QRect(roi_origin, roi_size))
             .intersected(QRect(QPoint(), _input_image_size));
     }
     emit roiChanged(_roi, _input_image_size);
 
 }
 
+QPointF ROIImageWidget::toWidget(const QPointF& point) const
+{
+    qreal x = point.x() * _image.width();
+    qreal y = point.y() * _image.height();
+    if(_flip_x)
+        x = _image.width() - x;
+    if(_flip_y)
+        y = _image.height() - y;
+    return QPointF(_image_origin) + QPointF(x, y);
+}
+
+QPointF ROIImageWidget::fromWidget(const QPointF& point) const
+{
+    Q_ASSERT(!_image.isNull());
+
+    qreal x = (point.x() - _image_origin.x()) / _image.width();
+    qreal y = (point.y() - _image_origin.y()) / _image.height();
+    return QPointF(_flip_x ? 1. - x : x, _flip_y ? 1. - y : y);
+}
+
+QRect ROIImageWidget::flipped(const QRect& rect) const
+{
+    QRect result = rect;
+    if(_flip_x)
+        result.moveLeft(_input_image_size.width() - rect.left() - rect.width());
+    if(_flip_y)
+        result.moveTop(_input_image_size.height() - rect.top() - rect.height());
+    return result;
+}
+
 
 } // namespace laser_painter
\ No newline at end of file
@@ -1,13 +1,21 @@
 #ifndef ROI_IMAGE_WIDGET
 #define ROI_IMAGE_WIDGET
 
+#include <QVector>
+#include <QPolygonF>
+
 #include "image_widget.h"
 
 class QRubberBand;
 
 namespace laser_painter {
 
-/// Image widget with selection of region of interest
+/// Image widget with selection of region of interest and edition of the
+/// detection mask.
+/// Mask polygons are edited by clicks with Shift (polygons where the laser
+/// is detected) or Ctrl (polygons where it is not), a polygon is finished
+/// with Enter. Backspace removes the last vertex, Delete removes all
+/// polygons.
 class ROIImageWidget: public ImageWidget
 {
     Q_OBJECT
@@ -15,13 +23,22 @@ class ROIImageWidget: public ImageWidget
 public:
     explicit ROIImageWidget(QWidget* parent = 0, Qt::WindowFlags f = 0);
 
+    void writeSettings() const;
+
 public slots:
     void setImage(const QImage& image);
+    /// @see ImageWidget::setFlip()
+    void setFlip(bool flip_x, bool flip_y);
+    // Emits a maskChanged() signal with the current mask
+    void emitMaskChanged() const;
 
 signals:
     /// Region of interest of the image with size @param image_rect is changed
     /// to @param roi.
     void roiChanged(const QRect& roi, const QSize& image_rect) const;
+    /// Detection mask polygons @param include and @param exclude (in
+    /// normalized coordinates of the input image) are changed.
+    void maskChanged(const QVector<QPolygonF>& include, const QVector<QPolygonF>& exclude) const;
 
 protected:
     // Selection handling
@@ -29,6 +46,7 @@ protected:
     void mouseMoveEvent(QMouseEvent* event);
     void mouseReleaseEvent(QMouseEvent* event);
     void keyPressEvent(QKeyEvent *event);
+    void paintEvent(QPaintEvent* event);
 
 private:
     void selectEntireImage(bool update_roi = true);
@@ -36,6 +54,11 @@ private:
     void updateInputGeometry(const QSize& input_image_size);
     void updateSelectionFromROI();
     void updateROIFromSelection();
+    // Mirror @param rect in the input image according to the flips.
+    QRect flipped(const QRect& rect) const;
+    // Mapping of normalized input image coordinates to widget coordinates
+    QPointF toWidget(const QPointF& point) const;
+    QPointF fromWidget(const QPointF& point) const;
 
 private:
     QSize _input_image_size;
@@ -45,6 +68,14 @@ private:
     QRubberBand* _selection;
     // For mouse events only.
     QPoint _selection_origin;
+    // Mask polygons (in normalized coordinates of the input image)
+    QVector<QPolygonF> _mask_include;
+    QVector<QPolygonF> _mask_exclude;
+    // Edited polygon
+    QPolygonF _mask_polygon;
+    bool _mask_polygon_excluded;
+    // The current mouse press edits the mask.
+    bool _editing_mask;
 };
 
 } // namespace laser_painter
@@ -0,0 +1,269 @@
+#include "stroke_canvas.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <QPainter>
+#include <QPolygonF>
+#include <QLineF>
+
+namespace laser_painter {
+
+StrokeCanvas::StrokeCanvas(const QSize& canvas_size, int cell_size)
+    : _canvas_size(canvas_size),
+    _cell_size(cell_size),
+    _nb_cols(1),
+    _nb_rows(1),
+    _points(),
+    _strokes(),
+    _cells(),
+    _nb_erased_points(0)
+{
+    Q_ASSERT(cell_size > 0);
+
+    clear();
+}
+
+bool StrokeCanvas::isEmpty() const
+{
+    return nbPoints() == 0;
+}
+
+int StrokeCanvas::nbPoints() const
+{
+    return _points.size() - _nb_erased_points;
+}
+
+void StrokeCanvas::clear()
+{
+    _points.clear();
+    _strokes.clear();
+    _nb_erased_points = 0;
+
+    _nb_cols = qMax(1, (_canvas_size.width() + _cell_size - 1) / _cell_size);
+    _nb_rows = qMax(1, (_canvas_size.height() + _cell_size - 1) / _cell_size);
+    _cells.clear();
+    _cells.resize(_nb_cols * _nb_rows);
+}
+
+void StrokeCanvas::setCanvasSize(const QSize& canvas_size)
+{
+    if(canvas_size == _canvas_size)
+        return;
+
+    if(_canvas_size.isEmpty() || canvas_size.isEmpty()) {
+        _canvas_size = canvas_size;
+        clear();
+        return;
+    }
+
+    const qreal scale_x = static_cast<qreal>(canvas_size.width()) / _canvas_size.width();
+    const qreal scale_y = static_cast<qreal>(canvas_size.height()) / _canvas_size.height();
+    for(int i = 0, size = _points.size(); i < size; ++i) {
+        _points[i].rx() *= scale_x;
+        _points[i].ry() *= scale_y;
+    }
+    for(int i = 0, size = _strokes.size(); i < size; ++i) {
+        QRectF& rect = _strokes[i].rect;
+        rect = QRectF(
+            QPointF(rect.left() * scale_x, rect.top() * scale_y),
+            QPointF(rect.right() * scale_x, rect.bottom() * scale_y)
+        );
+    }
+
+    _canvas_size = canvas_size;
+    rebuild();
+}
+
+QRectF StrokeCanvas::addStroke(const QPolygonF& stroke)
+{
+    if(stroke.isEmpty())
+        return QRectF();
+
+    Stroke s;
+    s.first = _points.size();
+    s.size = stroke.size();
+    // Never null, even for a single point stroke.
+    s.rect = stroke.boundingRect().adjusted(-.5, -.5, .5, .5);
+    s.erased = false;
+
+    for(int i = 0, size = stroke.size(); i < size; ++i)
+        _points.append(stroke[i]);
+    _strokes.append(s);
+    indexStroke(_strokes.size() - 1);
+
+    return s.rect;
+}
+
+QRectF StrokeCanvas::erase(const QPointF& pos, qreal radius)
+{
+    Q_ASSERT(radius >= 0);
+
+    int i_min, i_max, j_min, j_max;
+    cellRange(QRectF(pos.x() - radius, pos.y() - radius, 2 * radius, 2 * radius), i_min, i_max, j_min, j_max);
+
+    const qreal radius2 = radius * radius;
+    QRectF erased_rect;
+    for(int i = i_min; i <= i_max; ++i)
+        for(int j = j_min; j <= j_max; ++j) {
+            const QVector<Segment>& cell = _cells[i * _nb_cols + j];
+            for(int k = 0, size = cell.size(); k < size; ++k) {
+                Stroke& stroke = _strokes[cell[k].stroke];
+                if(stroke.erased)
+                    continue;
+
+                // Distance from pos to the segment
+                const QPointF& a = _points[cell[k].point];
+                const QPointF ab = segmentEnd(cell[k]) - a;
+                const QPointF ap = pos - a;
+                const qreal ab2 = QPointF::dotProduct(ab, ab);
+                const qreal t = ab2 > 0 ? qBound<qreal>(0, QPointF::dotProduct(ap, ab) / ab2, 1) : 0;
+                const QPointF e = ap - t * ab;
+                if(QPointF::dotProduct(e, e) > radius2)
+                    continue;
+
+                stroke.erased = true;
+                _nb_erased_points += stroke.size;
+                erased_rect |= stroke.rect;
+            }
+        }
+
+    if(_nb_erased_points > _points.size() / 2)
+        // Drop erased strokes from memory and index
+        rebuild();
+
+    return erased_rect;
+}
+
+void StrokeCanvas::paint(QPainter& painter, const QRectF& rect) const
+{
+    if(isEmpty())
+        return;
+
+    // Take stroke width into account
+    const qreal margin = qMax<qreal>(1., painter.pen().widthF()) / 2 + 1;
+    int i_min, i_max, j_min, j_max;
+    cellRange(rect.adjusted(-margin, -margin, margin, margin), i_min, i_max, j_min, j_max);
+
+    // A segment is registered in all the cells it crosses: collect the
+    // segments (identified by their first point) once.
+    QVector<Segment> segments;
+    for(int i = i_min; i <= i_max; ++i)
+        for(int j = j_min; j <= j_max; ++j) {
+            const QVector<Segment>& cell = _cells[i * _nb_cols + j];
+            for(int k = 0, size = cell.size(); k < size; ++k)
+                if(!_strokes[cell[k].stroke].erased)
+                    segments.append(cell[k]);
+        }
+    std::sort(segments.begin(), segments.end(), segmentLess);
+    segments.erase(std::unique(segments.begin(), segments.end(), segmentEqual), segments.end());
+
+    QVector<QLineF> lines;
+    QVector<QPointF> dots;
+    for(int k = 0, size = segments.size(); k < size; ++k) {
+        const QPointF& p0 = _points[segments[k].point];
+        const QPointF& p1 = segmentEnd(segments[k]);
+        if(p0 == p1)
+            dots.append(p0);
+        else
+            lines.append(QLineF(p0, p1));
+    }
+
+    painter.drawLines(lines);
+    painter.drawPoints(dots.constData(), dots.size());
+}
+
+void StrokeCanvas::indexStroke(int stroke_id)
+{
+    const Stroke& stroke = _strokes[stroke_id];
+    Segment segment;
+    segment.stroke = stroke_id;
+
+    // A single point stroke is a degenerated segment.
+    const int nb_segments = qMax(1, stroke.size - 1);
+    for(int k = 0; k < nb_segments; ++k) {
+        segment.point = stroke.first + k;
+
+        // Walk the cells crossed by the segment row by row, from the top
+        // end point a to the bottom end point b. Queries take the stroke
+        // width into account (@see paint()).
+        const QPointF& p0 = _points[segment.point];
+        const QPointF& p1 = segmentEnd(segment);
+        const QPointF& a = p0.y() <= p1.y() ? p0 : p1;
+        const QPointF& b = p0.y() <= p1.y() ? p1 : p0;
+        const qreal dx_dy = b.y() > a.y() ? (b.x() - a.x()) / (b.y() - a.y()) : 0;
+        const int i_a = cellRow(a.y());
+        const int i_b = cellRow(b.y());
+        for(int i = i_a; i <= i_b; ++i) {
+            // Part of the segment in the row (end rows include the parts out
+            // of the grid)
+            const qreal y0 = i == i_a ? a.y() : i * _cell_size;
+            const qreal y1 = i == i_b ? b.y() : (i + 1) * _cell_size;
+            const qreal x0 = i == i_a ? a.x() : a.x() + (y0 - a.y()) * dx_dy;
+            const qreal x1 = i == i_b ? b.x() : a.x() + (y1 - a.y()) * dx_dy;
+            const int j_min = cellColumn(qMin(x0, x1));
+            const int j_max = cellColumn(qMax(x0, x1));
+            for(int j = j_min; j <= j_max; ++j)
+                _cells[i * _nb_cols + j].append(segment);
+        }
+    }
+}
+
+void StrokeCanvas::rebuild()
+{
+    QVector<QPointF> points;
+    QVector<Stroke> strokes;
+    points.reserve(nbPoints());
+    for(int i = 0, size = _strokes.size(); i < size; ++i) {
+        Stroke stroke = _strokes[i];
+        if(stroke.erased)
+            continue;
+        const int first = points.size();
+        for(int k = 0; k < stroke.size; ++k)
+            points.append(_points[stroke.first + k]);
+        stroke.first = first;
+        strokes.append(stroke);
+    }
+
+    clear();
+    _points.swap(points);
+    _strokes.swap(strokes);
+    for(int i = 0, size = _strokes.size(); i < size; ++i)
+        indexStroke(i);
+}
+
+void StrokeCanvas::cellRange(const QRectF& rect, int& i_min, int& i_max, int& j_min, int& j_max) const
+{
+    i_min = cellRow(rect.top());
+    i_max = cellRow(rect.bottom());
+    j_min = cellColumn(rect.left());
+    j_max = cellColumn(rect.right());
+}
+
+int StrokeCanvas::cellRow(qreal y) const
+{
+    return qBound(0, static_cast<int>(std::floor(y / _cell_size)), _nb_rows - 1);
+}
+
+int StrokeCanvas::cellColumn(qreal x) const
+{
+    return qBound(0, static_cast<int>(std::floor(x / _cell_size)), _nb_cols - 1);
+}
+
+bool StrokeCanvas::segmentLess(const Segment& s1, const Segment& s2)
+{
+    return s1.point < s2.point;
+}
+
+bool StrokeCanvas::segmentEqual(const Segment& s1, const Segment& s2)
+{
+    return s1.point == s2.point;
+}
+
+const QPointF& StrokeCanvas::segmentEnd(const Segment& segment) const
+{
+    const Stroke& stroke = _strokes[segment.stroke];
+    return stroke.size == 1 ? _points[segment.point] : _points[segment.point + 1];
+}
+
+} // namespace laser_painter
\ No newline at end of file
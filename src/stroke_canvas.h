@@ -0,0 +1,89 @@
+#ifndef STROKE_CANVAS
+#define STROKE_CANVAS
+
+#include <QPointF>
+#include <QRectF>
+#include <QSize>
+#include <QVector>
+
+class QPainter;
+class QPolygonF;
+
+namespace laser_painter {
+
+/// Persistent strokes indexed by a uniform grid of cells.
+/// Painting, hit-testing and erasing cost is proportional to the number of
+/// stroke segments in the affected area, not to the total number of points.
+class StrokeCanvas
+{
+public:
+    /// @param cell_size size (in canvas pixels) of the index grid cells.
+    explicit StrokeCanvas(const QSize& canvas_size = QSize(), int cell_size = 32);
+
+    bool isEmpty() const;
+    /// Number of stored (non-erased) points.
+    int nbPoints() const;
+
+    /// Remove all strokes.
+    void clear();
+    /// Rescale strokes to the new canvas size @param canvas_size.
+    void setCanvasSize(const QSize& canvas_size);
+
+    /// Add a stroke @param stroke.
+    /// @return the stroke bounding rect.
+    QRectF addStroke(const QPolygonF& stroke);
+    /// Erase strokes passing within @param radius of @param pos.
+    /// @return the bounding rect of erased strokes (null if nothing is erased).
+    QRectF erase(const QPointF& pos, qreal radius);
+
+    /// Paint the strokes intersecting @param rect (in canvas coordinates)
+    /// with the current pen of @param painter.
+    void paint(QPainter& painter, const QRectF& rect) const;
+
+private:
+    struct Stroke {
+        // Index of the first point in _points
+        int first;
+        int size;
+        QRectF rect;
+        bool erased;
+    };
+    // Segment (or a single point stroke) reference in the grid cells.
+    struct Segment {
+        int stroke;
+        // Index of the first segment point in _points
+        int point;
+    };
+
+private:
+    // Insert segments of the stroke @param stroke_id in the grid.
+    void indexStroke(int stroke_id);
+    // Rebuild the grid (and drop erased strokes).
+    void rebuild();
+    // Range of cells covered by @param rect (clamped to the grid).
+    inline void cellRange(const QRectF& rect, int& i_min, int& i_max, int& j_min, int& j_max) const;
+    // Row and column of the cells at @param y and @param x (clamped to the
+    // grid)
+    inline int cellRow(qreal y) const;
+    inline int cellColumn(qreal x) const;
+    // Order segments by their first point (unique per segment).
+    static bool segmentLess(const Segment& s1, const Segment& s2);
+    static bool segmentEqual(const Segment& s1, const Segment& s2);
+    // Segment end points
+    inline const QPointF& segmentEnd(const Segment& segment) const;
+
+private:
+    QSize _canvas_size;
+    int _cell_size;
+    int _nb_cols;
+    int _nb_rows;
+    QVector<QPointF> _points;
+    QVector<Stroke> _strokes;
+    // Grid cells (row major) with the segments crossing the cell.
+    QVector<QVector<Segment> > _cells;
+    int _nb_erased_points;
+};
+
+} // namespace laser_painter
+
+#endif // STROKE_CANVAS
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "stroke_log_codec.h"
+
+#include <cstring>
+
+namespace laser_painter {
+
+using namespace stroke_log;
+
+StrokeLogEncoder::StrokeLogEncoder()
+    : _time(0),
+    _pos()
+{}
+
+void StrokeLogEncoder::writeHeader(QByteArray& out, const QSize& canvas_size)
+{
+    _time = 0;
+    _pos = QPoint();
+
+    out.append(magic, 4);
+    out.append(static_cast<char>(version));
+    writeVarint(out, qMax(0, canvas_size.width()));
+    writeVarint(out, qMax(0, canvas_size.height()));
+}
+
+void StrokeLogEncoder::beginStroke(QByteArray& out, qint64 time, const QPointF& pos)
+{
+    writeTag(out, StrokeBegin, time);
+    _pos = toFixedPoint(pos);
+    writeZigzag(out, _pos.x());
+    writeZigzag(out, _pos.y());
+}
+
+void StrokeLogEncoder::addPoint(QByteArray& out, qint64 time, const QPointF& pos)
+{
+    writeTag(out, StrokePoint, time);
+    QPoint fixed_pos = toFixedPoint(pos);
+    writeZigzag(out, fixed_pos.x() - _pos.x());
+    writeZigzag(out, fixed_pos.y() - _pos.y());
+    _pos = fixed_pos;
+}
+
+void StrokeLogEncoder::endStroke(QByteArray& out, qint64 time)
+{
+    writeTag(out, StrokeEnd, time);
+}
+
+void StrokeLogEncoder::setCanvasSize(QByteArray& out, qint64 time, const QSize& canvas_size)
+{
+    writeTag(out, CanvasSize, time);
+    writeVarint(out, qMax(0, canvas_size.width()));
+    writeVarint(out, qMax(0, canvas_size.height()));
+}
+
+void StrokeLogEncoder::writeTag(QByteArray& out, RecordType type, qint64 time)
+{
+    Q_ASSERT(time >= _time);
+
+    out.append(static_cast<char>(type));
+    writeVarint(out, time - _time);
+    _time = time;
+}
+
+void StrokeLogEncoder::writeVarint(QByteArray& out, quint64 value)
+{
+    while(value >= 0x80) {
+        out.append(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.append(static_cast<char>(value));
+}
+
+void StrokeLogEncoder::writeZigzag(QByteArray& out, qint64 value)
+{
+    writeVarint(out, (static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63));
+}
+
+QPoint StrokeLogEncoder::toFixedPoint(const QPointF& pos)
+{
+    return QPoint(
+        qRound(pos.x() * (1 << fixed_point_bits)),
+        qRound(pos.y() * (1 << fixed_point_bits))
+    );
+}
+
+StrokeLogDecoder::StrokeLogDecoder(const uchar* data, qint64 size)
+    : _data(data),
+    _size(size),
+    _offset(0),
+    _valid(false),
+    _header_canvas_size(),
+    _time(0),
+    _pos(),
+    _canvas_size()
+{
+    if(!_data || _size < 5 || std::memcmp(_data, magic, 4) != 0 || _data[4] != version)
+        return;
+
+    _offset = 5;
+    quint64 width, height;
+    if(!readVarint(width) || !readVarint(height))
+        return;
+
+    _header_canvas_size = QSize(width, height);
+    _canvas_size = _header_canvas_size;
+    _valid = true;
+}
+
+bool StrokeLogDecoder::isValid() const
+{
+    return _valid;
+}
+
+QSize StrokeLogDecoder::headerCanvasSize() const
+{
+    return _header_canvas_size;
+}
+
+RecordType StrokeLogDecoder::next()
+{
+    if(!_valid || _offset >= _size)
+        return EndOfLog;
+
+    const qint64 record_offset = _offset;
+    const RecordType type = static_cast<RecordType>(_data[_offset++]);
+
+    quint64 dt;
+    if(!readVarint(dt)) {
+        _offset = record_offset;
+        return EndOfLog;
+    }
+
+    bool complete = true;
+    switch(type) {
+    case StrokeBegin:
+    case StrokePoint: {
+        qint64 x, y;
+        complete = readZigzag(x) && readZigzag(y);
+        if(!complete)
+            break;
+        if(type == StrokeBegin)
+            _pos = QPoint(x, y);
+        else
+            _pos += QPoint(x, y);
+        break;
+    }
+    case StrokeEnd:
+        break;
+    case CanvasSize: {
+        quint64 width, height;
+        complete = readVarint(width) && readVarint(height);
+        if(complete)
+            _canvas_size = QSize(width, height);
+        break;
+    }
+    default:
+        // Corrupted log: stop here.
+        _offset = _size;
+        return InvalidRecord;
+    }
+
+    if(!complete) {
+        // Truncated record (the log is still being written or was interrupted)
+        _offset = record_offset;
+        return EndOfLog;
+    }
+
+    _time += dt;
+    return type;
+}
+
+qint64 StrokeLogDecoder::time() const
+{
+    return _time;
+}
+
+QPointF StrokeLogDecoder::pos() const
+{
+    return QPointF(_pos) / (1 << fixed_point_bits);
+}
+
+QSize StrokeLogDecoder::canvasSize() const
+{
+    return _canvas_size;
+}
+
+qint64 StrokeLogDecoder::offset() const
+{
+    return _offset;
+}
+
+void StrokeLogDecoder::seek(qint64 offset)
+{
+    Q_ASSERT(offset >= 0 && offset <= _size);
+
+    _offset = offset;
+}
+
+bool StrokeLogDecoder::readVarint(quint64& value)
+{
+    value = 0;
+    for(int shift = 0; shift < 64 && _offset < _size; shift += 7) {
+        uchar byte = _data[_offset++];
+        value |= static_cast<quint64>(byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+bool StrokeLogDecoder::readZigzag(qint64& value)
+{
+    quint64 zigzag;
+    if(!readVarint(zigzag))
+        return false;
+    value = static_cast<qint64>(zigzag >> 1) ^ -static_cast<qint64>(zigzag & 1);
+    return true;
+}
+
+} // namespace laser_painter
\ No newline at end of file
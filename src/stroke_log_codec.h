@@ -0,0 +1,110 @@
+#ifndef STROKE_LOG_CODEC
+#define STROKE_LOG_CODEC
+
+#include <QByteArray>
+#include <QPoint>
+#include <QPointF>
+#include <QSize>
+
+namespace laser_painter {
+
+/// Binary stroke log format.
+///
+/// A log starts with a header: the "LPSL" magic, a version byte and the canvas
+/// width and height (varints). It's followed by records. Each record is a tag
+/// byte (RecordType) and a time delta (varint, milliseconds since the
+/// previous record), then:
+/// - StrokeBegin: absolute position (zigzag varints x, y);
+/// - StrokePoint: position relative to the previous one (zigzag varints);
+/// - StrokeEnd: nothing;
+/// - CanvasSize: canvas width and height (varints).
+/// Positions are fixed-point with fixed_point_bits fractional bits.
+namespace stroke_log {
+    enum RecordType {
+        InvalidRecord = 0,
+        StrokeBegin = 'B',
+        StrokePoint = 'P',
+        StrokeEnd = 'E',
+        CanvasSize = 'C',
+        EndOfLog = 0xff
+    };
+
+    const char magic[] = "LPSL";
+    const uchar version = 1;
+    const int fixed_point_bits = 4;
+}
+
+/// Encode strokes into the stroke log format.
+class StrokeLogEncoder
+{
+public:
+    StrokeLogEncoder();
+
+    /// Append the log header to @param out and reset the encoder.
+    void writeHeader(QByteArray& out, const QSize& canvas_size);
+    /// Append a record to @param out. @param time is in milliseconds and
+    /// mustn't decrease between records.
+    void beginStroke(QByteArray& out, qint64 time, const QPointF& pos);
+    void addPoint(QByteArray& out, qint64 time, const QPointF& pos);
+    void endStroke(QByteArray& out, qint64 time);
+    void setCanvasSize(QByteArray& out, qint64 time, const QSize& canvas_size);
+
+private:
+    inline void writeTag(QByteArray& out, stroke_log::RecordType type, qint64 time);
+    static inline void writeVarint(QByteArray& out, quint64 value);
+    static inline void writeZigzag(QByteArray& out, qint64 value);
+    static inline QPoint toFixedPoint(const QPointF& pos);
+
+private:
+    qint64 _time;
+    // Previous position (fixed-point)
+    QPoint _pos;
+};
+
+/// Decode a stroke log from memory (e.g. a memory-mapped file).
+/// Truncated logs are decoded up to the last complete record.
+class StrokeLogDecoder
+{
+public:
+    /// @param data should stay valid during the decoder lifetime.
+    StrokeLogDecoder(const uchar* data, qint64 size);
+
+    /// Check the log header.
+    bool isValid() const;
+    /// Canvas size from the log header.
+    QSize headerCanvasSize() const;
+
+    /// Decode the next record and return its type.
+    stroke_log::RecordType next();
+    /// Record data
+    qint64 time() const;
+    QPointF pos() const;
+    QSize canvasSize() const;
+
+    /// Offset of the next record.
+    qint64 offset() const;
+    /// Continue decoding from the record at @param offset (returned by
+    /// offset()). Relative records are decoded correctly only from a
+    /// StrokeBegin record.
+    void seek(qint64 offset);
+
+private:
+    inline bool readVarint(quint64& value);
+    inline bool readZigzag(qint64& value);
+
+private:
+    const uchar* _data;
+    qint64 _size;
+    qint64 _offset;
+    bool _valid;
+    QSize _header_canvas_size;
+
+    qint64 _time;
+    // Current position (fixed-point)
+    QPoint _pos;
+    QSize _canvas_size;
+};
+
+} // namespace laser_painter
+
+#endif // STROKE_LOG_CODEC
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "stroke_log_file.h"
+
+#include <QByteArray>
+#include <QFileInfo>
+#include <QDir>
+
+namespace laser_painter {
+
+StrokeLogFile::StrokeLogFile(QObject* parent)
+    : QObject(parent),
+    _file()
+{}
+
+void StrokeLogFile::open(const QString& path)
+{
+    close();
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    _file.setFileName(path);
+    if(!_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        emit warning(tr("Stroke log: cannot create %1").arg(path));
+}
+
+void StrokeLogFile::write(const QByteArray& data)
+{
+    if(!_file.isOpen())
+        return;
+
+    if(_file.write(data) != data.size()) {
+        emit warning(tr("Stroke log: cannot write to %1").arg(_file.fileName()));
+        _file.close();
+        return;
+    }
+    // Keep the log readable (replay, export) while it's being written.
+    _file.flush();
+}
+
+void StrokeLogFile::sync()
+{
+    if(_file.isOpen())
+        _file.flush();
+}
+
+void StrokeLogFile::close()
+{
+    if(_file.isOpen())
+        _file.close();
+}
+
+} // namespace laser_painter
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef STROKE_LOG_FILE
+#define STROKE_LOG_FILE
+
+#include <QObject>
+#include <QFile>
+
+class QByteArray;
+
+namespace laser_painter {
+
+/// Append encoded stroke log data to a file.
+/// Lives in a background thread of StrokeLogWriter, so disk I/O never blocks
+/// the caller.
+class StrokeLogFile : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StrokeLogFile(QObject* parent = 0);
+
+public slots:
+    /// Close the current file (if any) and create a new file @param path.
+    void open(const QString& path);
+    void write(const QByteArray& data);
+    /// Write the buffered data of the file to the disk.
+    void sync();
+    void close();
+
+signals:
+    void warning(const QString& text) const;
+
+private:
+    QFile _file;
+};
+
+} // namespace laser_painter
+
+#endif // STROKE_LOG_FILE
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "stroke_log_player.h"
+
+#include <QTimer>
+#include <QPointF>
+#include <QSize>
+
+#include "stroke_log_codec.h"
+
+namespace laser_painter {
+
+StrokeLogPlayer::StrokeLogPlayer(QObject* parent)
+    : QObject(parent),
+    _file(),
+    _data(0),
+    _decoder(0),
+    _pending_record(stroke_log::InvalidRecord),
+    _fast(false),
+    _clock()
+{
+    _timer = new QTimer(this);
+    _timer->setInterval(_timer_interval);
+    connect(_timer, &QTimer::timeout, this, &StrokeLogPlayer::playRecords);
+}
+
+StrokeLogPlayer::~StrokeLogPlayer()
+{
+    stop();
+}
+
+bool StrokeLogPlayer::isPlaying() const
+{
+    return _decoder != 0;
+}
+
+void StrokeLogPlayer::play(const QString& path, bool fast)
+{
+    stop();
+
+    _file.setFileName(path);
+    if(!_file.open(QIODevice::ReadOnly)) {
+        emit warning(tr("Stroke log: cannot open %1").arg(path));
+        return;
+    }
+    _data = _file.map(0, _file.size());
+    if(!_data) {
+        emit warning(tr("Stroke log: cannot map %1").arg(path));
+        _file.close();
+        return;
+    }
+    _decoder = new StrokeLogDecoder(_data, _file.size());
+    if(!_decoder->isValid()) {
+        emit warning(tr("Stroke log: %1 is not a valid stroke log").arg(path));
+        stop();
+        return;
+    }
+
+    _fast = fast;
+    _pending_record = stroke_log::InvalidRecord;
+    emit started();
+    emit canvasSizeChanged(_decoder->headerCanvasSize());
+    _clock.start();
+    _timer->start();
+}
+
+void StrokeLogPlayer::stop()
+{
+    bool was_playing = isPlaying();
+
+    _timer->stop();
+    delete _decoder;
+    _decoder = 0;
+    if(_data) {
+        _file.unmap(_data);
+        _data = 0;
+    }
+    _file.close();
+
+    if(was_playing)
+        emit finished();
+}
+
+void StrokeLogPlayer::playRecords()
+{
+    Q_ASSERT(_decoder);
+
+    for(int nb_records = 0; !_fast || nb_records < _fast_nb_records; ++nb_records) {
+        if(_pending_record == stroke_log::InvalidRecord) {
+            stroke_log::RecordType type = _decoder->next();
+            if(type == stroke_log::EndOfLog || type == stroke_log::InvalidRecord) {
+                if(type == stroke_log::InvalidRecord)
+                    emit warning(tr("Stroke log: corrupted log"));
+                stop();
+                return;
+            }
+            _pending_record = type;
+        }
+
+        if(!_fast && _decoder->time() > _clock.elapsed())
+            // Wait for the record time
+            return;
+
+        switch(_pending_record) {
+        case stroke_log::StrokeBegin:
+        case stroke_log::StrokePoint:
+            emit tipAvailable(_decoder->pos());
+            break;
+        case stroke_log::StrokeEnd:
+            emit trackEnded();
+            break;
+        case stroke_log::CanvasSize:
+            emit canvasSizeChanged(_decoder->canvasSize());
+            break;
+        default:
+            Q_ASSERT(false);
+        }
+        _pending_record = stroke_log::InvalidRecord;
+    }
+}
+
+} // namespace laser_painter
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef STROKE_LOG_PLAYER
+#define STROKE_LOG_PLAYER
+
+#include <QObject>
+#include <QFile>
+#include <QElapsedTimer>
+
+class QTimer;
+class QPointF;
+class QSize;
+
+namespace laser_painter {
+    class StrokeLogDecoder;
+}
+
+namespace laser_painter {
+
+/// Replay a stroke log (@see StrokeLogEncoder) in real time or as fast as
+/// possible. The log file is memory-mapped.
+class StrokeLogPlayer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StrokeLogPlayer(QObject* parent = 0);
+    ~StrokeLogPlayer();
+
+    bool isPlaying() const;
+
+public slots:
+    /// Stop the current replay (if any) and replay the log @param path.
+    /// If @param fast is true, replay as fast as possible instead of the
+    /// recording speed.
+    void play(const QString& path, bool fast = false);
+    void stop();
+
+signals:
+    void started() const;
+    void finished() const;
+
+    void canvasSizeChanged(const QSize& canvas_size) const;
+    /// Stroke tip (found is always true)
+    void tipAvailable(const QPointF& pos, bool found = true) const;
+    void trackEnded() const;
+
+    void warning(const QString& text) const;
+
+private slots:
+    /// Emit the records up to the current replay time.
+    void playRecords();
+
+private:
+    QFile _file;
+    uchar* _data;
+    StrokeLogDecoder* _decoder;
+    // Type of the decoded record waiting for its replay time (if any)
+    int _pending_record;
+    bool _fast;
+    QElapsedTimer _clock;
+    QTimer* _timer;
+    static const int _timer_interval = 5; // milliseconds
+    // Maximum number of records emitted per timer tick in the fast mode
+    // (let the event loop paint between bunches).
+    static const int _fast_nb_records = 512;
+};
+
+} // namespace laser_painter
+
+#endif // STROKE_LOG_PLAYER
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "stroke_log_writer.h"
+
+#include <QThread>
+#include <QTimer>
+#include <QMetaObject>
+
+#include "stroke_log_file.h"
+
+namespace laser_painter {
+
+StrokeLogWriter::StrokeLogWriter(QObject* parent)
+    : QObject(parent),
+    _encoder(),
+    _buffer(),
+    _clock(),
+    _path(),
+    _canvas_size(),
+    _recording(true),
+    _in_stroke(false)
+{
+    _buffer.reserve(_flush_size);
+
+    _thread = new QThread(this);
+    _file = new StrokeLogFile();
+    _file->moveToThread(_thread);
+    connect(_thread, &QThread::finished, _file, &QObject::deleteLater);
+    // Queued connections (objects live in different threads)
+    connect(this, &StrokeLogWriter::fileOpenRequested, _file, &StrokeLogFile::open);
+    connect(this, &StrokeLogWriter::dataAvailable, _file, &StrokeLogFile::write);
+    connect(this, &StrokeLogWriter::fileCloseRequested, _file, &StrokeLogFile::close);
+    connect(_file, &StrokeLogFile::warning, this, &StrokeLogWriter::warning);
+    _thread->start(QThread::LowPriority);
+
+    _flush_timer = new QTimer(this);
+    _flush_timer->setInterval(_flush_interval);
+    connect(_flush_timer, &QTimer::timeout, this, &StrokeLogWriter::flush);
+}
+
+StrokeLogWriter::~StrokeLogWriter()
+{
+    close();
+    // Wait for the pending writes: queued calls are processed in order.
+    QMetaObject::invokeMethod(_file, "close", Qt::BlockingQueuedConnection);
+    _thread->quit();
+    _thread->wait();
+}
+
+QString StrokeLogWriter::path() const
+{
+    return _path;
+}
+
+void StrokeLogWriter::open(const QString& path, const QSize& canvas_size)
+{
+    close();
+
+    _path = path;
+    _canvas_size = canvas_size;
+    _clock.start();
+    emit fileOpenRequested(_path);
+    _encoder.writeHeader(_buffer, _canvas_size);
+    _flush_timer->start();
+}
+
+void StrokeLogWriter::close()
+{
+    if(_path.isEmpty())
+        return;
+
+    endTrack();
+    flush();
+    emit fileCloseRequested();
+    _flush_timer->stop();
+    _path.clear();
+}
+
+void StrokeLogWriter::setRecording(bool enabled)
+{
+    if(!enabled)
+        endTrack();
+    _recording = enabled;
+}
+
+void StrokeLogWriter::addTip(const QPointF& pos)
+{
+    if(_path.isEmpty() || !_recording)
+        return;
+
+    if(_in_stroke)
+        _encoder.addPoint(_buffer, time(), pos);
+    else {
+        _encoder.beginStroke(_buffer, time(), pos);
+        _in_stroke = true;
+    }
+
+    if(_buffer.size() >= _flush_size)
+        flush();
+}
+
+void StrokeLogWriter::endTrack()
+{
+    if(!_in_stroke)
+        return;
+
+    _encoder.endStroke(_buffer, time());
+    _in_stroke = false;
+}
+
+void StrokeLogWriter::setCanvasSize(const QSize& canvas_size)
+{
+    if(canvas_size == _canvas_size)
+        return;
+
+    _canvas_size = canvas_size;
+    if(_path.isEmpty())
+        return;
+
+    endTrack();
+    _encoder.setCanvasSize(_buffer, time(), _canvas_size);
+}
+
+void StrokeLogWriter::flush()
+{
+    if(_buffer.isEmpty())
+        return;
+
+    emit dataAvailable(_buffer);
+    // Don't detach the sent data, start a new buffer.
+    _buffer = QByteArray();
+    _buffer.reserve(_flush_size);
+}
+
+void StrokeLogWriter::sync()
+{
+    flush();
+    // Queued calls are processed in order: the data is written on return.
+    QMetaObject::invokeMethod(_file, "sync", Qt::BlockingQueuedConnection);
+}
+
+qint64 StrokeLogWriter::time() const
+{
+    return _clock.elapsed();
+}
+
+} // namespace laser_painter
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef STROKE_LOG_WRITER
+#define STROKE_LOG_WRITER
+
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QSize>
+
+#include "stroke_log_codec.h"
+
+class QThread;
+class QTimer;
+
+namespace laser_painter {
+    class StrokeLogFile;
+}
+
+namespace laser_painter {
+
+/// Record drawn strokes into a stroke log file (@see StrokeLogEncoder).
+/// Strokes are encoded into a memory buffer which is periodically handed to
+/// a background thread for writing.
+class StrokeLogWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StrokeLogWriter(QObject* parent = 0);
+    /// Flush and close the current log.
+    ~StrokeLogWriter();
+
+    /// Path of the current log (empty if there's no open log).
+    QString path() const;
+
+public slots:
+    /// Close the current log (if any) and start a new log @param path.
+    void open(const QString& path, const QSize& canvas_size);
+    void close();
+    /// Suspend (@param enabled = false) or resume recording. The current
+    /// stroke, if any, is ended when recording is suspended.
+    void setRecording(bool enabled);
+
+    void addTip(const QPointF& pos);
+    void endTrack();
+    void setCanvasSize(const QSize& canvas_size);
+
+    /// Hand the buffered data to the writing thread.
+    void flush();
+    /// Flush and wait until the data is written: the log file is complete
+    /// when the call returns.
+    void sync();
+
+signals:
+    void warning(const QString& text) const;
+
+    // Connections to the writing thread
+    void fileOpenRequested(const QString& path) const;
+    void dataAvailable(const QByteArray& data) const;
+    void fileCloseRequested() const;
+
+private:
+    inline qint64 time() const;
+
+private:
+    StrokeLogEncoder _encoder;
+    QByteArray _buffer;
+    QElapsedTimer _clock;
+    QString _path;
+    QSize _canvas_size;
+    bool _recording;
+    bool _in_stroke;
+
+    QThread* _thread;
+    StrokeLogFile* _file;
+    QTimer* _flush_timer;
+    static const int _flush_interval = 1000; // milliseconds
+    static const int _flush_size = 64 * 1024; // bytes
+};
+
+} // namespace laser_painter
+
+#endif // STROKE_LOG_WRITER
\ No newline at end of file
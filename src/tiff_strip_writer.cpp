@@ -0,0 +1,206 @@
+#include "tiff_strip_writer.h"
+
+#include <QImage>
+
+namespace laser_painter {
+
+TiffStripWriter::TiffStripWriter()
+    : _file(),
+    _width(0),
+    _height(0),
+    _rows_per_strip(0),
+    _nb_written_rows(0)
+{}
+
+TiffStripWriter::~TiffStripWriter()
+{
+    if(_file.isOpen())
+        _file.close();
+}
+
+bool TiffStripWriter::open(const QString& path, int width, int height, int rows_per_strip)
+{
+    Q_ASSERT(width > 0 && height > 0 && rows_per_strip > 0);
+
+    _width = width;
+    _height = height;
+    _rows_per_strip = rows_per_strip;
+    _nb_written_rows = 0;
+    _strip_offsets.clear();
+    _strip_byte_counts.clear();
+    _error.clear();
+
+    _file.setFileName(path);
+    if(!_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return fail(_file.errorString());
+
+    // Little endian header. The directory offset is patched by close().
+    QByteArray header("II", 2);
+    append16(header, 42);
+    append32(header, 0);
+    if(_file.write(header) != header.size())
+        return fail(_file.errorString());
+
+    return true;
+}
+
+bool TiffStripWriter::writeStrip(const QImage& strip)
+{
+    Q_ASSERT(_file.isOpen());
+    Q_ASSERT(strip.width() == _width);
+    Q_ASSERT(strip.format() == QImage::Format_RGB32 || strip.format() == QImage::Format_ARGB32);
+    Q_ASSERT(_nb_written_rows < _height);
+
+    const int nb_rows = qMin(_rows_per_strip, _height - _nb_written_rows);
+    Q_ASSERT(strip.height() >= nb_rows);
+
+    _row.resize(3 * _width);
+    _packed.clear();
+    for(int i = 0; i < nb_rows; ++i) {
+        const QRgb* src = reinterpret_cast<const QRgb*>(strip.constScanLine(i));
+        uchar* dst = reinterpret_cast<uchar*>(_row.data());
+        for(int j = 0; j < _width; ++j) {
+            *dst++ = qRed(src[j]);
+            *dst++ = qGreen(src[j]);
+            *dst++ = qBlue(src[j]);
+        }
+        // Rows are packed separately
+        packBits(reinterpret_cast<const uchar*>(_row.constData()), _row.size(), _packed);
+    }
+
+    const qint64 offset = _file.pos();
+    if(offset + _packed.size() > Q_INT64_C(0xffffffff))
+        return fail(QObject::tr("Image is too large for the TIFF format"));
+    if(_file.write(_packed) != _packed.size())
+        return fail(_file.errorString());
+
+    _strip_offsets.append(offset);
+    _strip_byte_counts.append(_packed.size());
+    _nb_written_rows += nb_rows;
+    return true;
+}
+
+bool TiffStripWriter::close()
+{
+    Q_ASSERT(_file.isOpen());
+    Q_ASSERT(_nb_written_rows == _height);
+
+    // Values which don't fit into a directory entry (word aligned)
+    QByteArray data;
+    if(_file.pos() % 2)
+        data.append('\0');
+    const quint32 data_offset = _file.pos() + data.size();
+
+    const quint32 bits_per_sample_offset = data_offset + data.size();
+    append16(data, 8);
+    append16(data, 8);
+    append16(data, 8);
+    const quint32 resolution_offset = data_offset + data.size();
+    append32(data, 72);
+    append32(data, 1);
+    const int nb_strips = _strip_offsets.size();
+    const quint32 strip_offsets_offset = data_offset + data.size();
+    for(int i = 0; i < nb_strips; ++i)
+        append32(data, _strip_offsets[i]);
+    const quint32 strip_byte_counts_offset = data_offset + data.size();
+    for(int i = 0; i < nb_strips; ++i)
+        append32(data, _strip_byte_counts[i]);
+
+    // Image file directory (entries sorted by tag)
+    const quint32 directory_offset = data_offset + data.size();
+    const quint16 SHORT = 3, LONG = 4, RATIONAL = 5;
+    append16(data, 13);
+    appendEntry(data, 256, LONG, 1, _width); // ImageWidth
+    appendEntry(data, 257, LONG, 1, _height); // ImageLength
+    appendEntry(data, 258, SHORT, 3, bits_per_sample_offset); // BitsPerSample
+    appendEntry(data, 259, SHORT, 1, 32773); // Compression: PackBits
+    appendEntry(data, 262, SHORT, 1, 2); // PhotometricInterpretation: RGB
+    appendEntry(data, 273, LONG, nb_strips, nb_strips == 1 ? _strip_offsets[0] : strip_offsets_offset); // StripOffsets
+    appendEntry(data, 277, SHORT, 1, 3); // SamplesPerPixel
+    appendEntry(data, 278, LONG, 1, _rows_per_strip); // RowsPerStrip
+    appendEntry(data, 279, LONG, nb_strips, nb_strips == 1 ? _strip_byte_counts[0] : strip_byte_counts_offset); // StripByteCounts
+    appendEntry(data, 282, RATIONAL, 1, resolution_offset); // XResolution
+    appendEntry(data, 283, RATIONAL, 1, resolution_offset); // YResolution
+    appendEntry(data, 284, SHORT, 1, 1); // PlanarConfiguration: chunky
+    appendEntry(data, 296, SHORT, 1, 2); // ResolutionUnit: inch
+    append32(data, 0); // No next directory
+
+    if(_file.write(data) != data.size())
+        return fail(_file.errorString());
+
+    // Patch the directory offset in the header
+    QByteArray header_offset;
+    append32(header_offset, directory_offset);
+    if(!_file.seek(4) || _file.write(header_offset) != header_offset.size())
+        return fail(_file.errorString());
+
+    _file.close();
+    return true;
+}
+
+QString TiffStripWriter::errorString() const
+{
+    return _error;
+}
+
+bool TiffStripWriter::fail(const QString& error)
+{
+    _error = error;
+    if(_file.isOpen())
+        _file.close();
+    return false;
+}
+
+void TiffStripWriter::packBits(const uchar* data, int size, QByteArray& out)
+{
+    int i = 0;
+    while(i < size) {
+        // Replicate run
+        int run = 1;
+        while(i + run < size && run < 128 && data[i + run] == data[i])
+            ++run;
+        if(run >= 3) {
+            out.append(static_cast<char>(1 - run));
+            out.append(static_cast<char>(data[i]));
+            i += run;
+            continue;
+        }
+
+        // Literal run, up to the next replicate run of 3 bytes
+        const int begin = i;
+        while(i < size && i - begin < 128) {
+            if(i + 2 < size && data[i] == data[i + 1] && data[i] == data[i + 2])
+                break;
+            ++i;
+        }
+        out.append(static_cast<char>(i - begin - 1));
+        out.append(reinterpret_cast<const char*>(data + begin), i - begin);
+    }
+}
+
+void TiffStripWriter::append16(QByteArray& out, quint16 value)
+{
+    out.append(static_cast<char>(value & 0xff));
+    out.append(static_cast<char>(value >> 8));
+}
+
+void TiffStripWriter::append32(QByteArray& out, quint32 value)
+{
+    append16(out, value & 0xffff);
+    append16(out, value >> 16);
+}
+
+void TiffStripWriter::appendEntry(QByteArray& out, quint16 tag, quint16 type, quint32 count, quint32 value)
+{
+    append16(out, tag);
+    append16(out, type);
+    append32(out, count);
+    if(type == 3 && count == 1) {
+        // Short values are left-justified
+        append16(out, value);
+        append16(out, 0);
+    } else
+        append32(out, value);
+}
+
+} // namespace laser_painter
\ No newline at end of file
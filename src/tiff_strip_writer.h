@@ -0,0 +1,59 @@
+#ifndef TIFF_STRIP_WRITER
+#define TIFF_STRIP_WRITER
+
+#include <QFile>
+#include <QVector>
+#include <QByteArray>
+
+class QImage;
+
+namespace laser_painter {
+
+/// Write an RGB TIFF image strip by strip (PackBits compressed), without
+/// keeping the entire image in memory.
+class TiffStripWriter
+{
+public:
+    TiffStripWriter();
+    ~TiffStripWriter();
+
+    /// Create the file @param path for an image of size @param width x
+    /// @param height, written by strips of @param rows_per_strip rows.
+    bool open(const QString& path, int width, int height, int rows_per_strip);
+    /// Write the next strip from @param strip (Format_RGB32 or Format_ARGB32
+    /// image with the image width). Only the first rows of the last strip
+    /// are written.
+    bool writeStrip(const QImage& strip);
+    /// Write the image directory and close the file.
+    /// All the strips should be written.
+    bool close();
+
+    QString errorString() const;
+
+private:
+    bool fail(const QString& error);
+    // PackBits compression of @param size bytes from @param data.
+    static void packBits(const uchar* data, int size, QByteArray& out);
+    // Append little endian values to @param out.
+    static inline void append16(QByteArray& out, quint16 value);
+    static inline void append32(QByteArray& out, quint32 value);
+    // Append an image file directory entry to @param out.
+    static inline void appendEntry(QByteArray& out, quint16 tag, quint16 type, quint32 count, quint32 value);
+
+private:
+    QFile _file;
+    int _width;
+    int _height;
+    int _rows_per_strip;
+    int _nb_written_rows;
+    QVector<quint32> _strip_offsets;
+    QVector<quint32> _strip_byte_counts;
+    // Buffers reused between strips
+    QByteArray _row;
+    QByteArray _packed;
+    QString _error;
+};
+
+} // namespace laser_painter
+
+#endif // TIFF_STRIP_WRITER
\ No newline at end of file
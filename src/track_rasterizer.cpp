@@ -0,0 +1,342 @@
+#include "track_rasterizer.h"
+
+#include <QPainter>
+#include <QPen>
+#include <QLineF>
+#include <QVector>
+#include <QMetaObject>
+
+namespace laser_painter {
+
+TrackRasterizer::TrackRasterizer(QObject* parent)
+    : QObject(parent),
+    _size(),
+    _canvas_size(),
+    _transform(),
+    _track(),
+    _simplifier(),
+    _max_track_size(2),
+    _old_track(),
+    _old_track_opacity(0),
+    _strokes(),
+    _persistent(false),
+    _track_color(Qt::magenta),
+    _track_width(3),
+    _canvas_color(Qt::black),
+    _back_buffer(0),
+    _dirty_rect(),
+    _previous_dirty_rect(),
+    _render_scheduled(false),
+    _render_pending(false)
+{}
+
+void TrackRasterizer::resize(const QSize& size)
+{
+    if(size == _size)
+        return;
+
+    _size = size;
+    _background = QImage(_size, QImage::Format_ARGB32_Premultiplied);
+    _live = QImage(_size, QImage::Format_ARGB32_Premultiplied);
+    _fading = QImage(_size, QImage::Format_ARGB32_Premultiplied);
+    _buffers[0] = QImage(_size, QImage::Format_ARGB32_Premultiplied);
+    _buffers[1] = QImage(_size, QImage::Format_ARGB32_Premultiplied);
+    redrawAll();
+}
+
+void TrackRasterizer::setCanvasSize(const QSize& canvas_size)
+{
+    _canvas_size = canvas_size;
+    _strokes.setCanvasSize(canvas_size);
+    // Prevent painting irrelevant tracks after rescaling
+    _track.clear();
+    _old_track.clear();
+    _simplifier.reset();
+    redrawAll();
+}
+
+void TrackRasterizer::addTip(const QPointF& pos)
+{
+    // Points of the modified track segments
+    QPolygonF dirty_points;
+    dirty_points.append(pos);
+    if(!_track.isEmpty())
+        dirty_points.append(_track.last());
+
+    if(_simplifier.add(pos))
+        _track.append(pos);
+    else
+        // Tip is close to the track, move its last point
+        _track.last() = pos;
+    if(_track.size() > 1)
+        dirty_points.append(_track[_track.size() - 2]);
+
+    if(_track.size() > _max_track_size) {
+        // Remove 5% of track
+        const int nb_removed = _track.size() - _max_track_size
+            + static_cast<int>(0.05 * _max_track_size);
+        if(_persistent) {
+            // Keep the removed part (up to the first kept point) in the
+            // persistent canvas.
+            QRect rect = toWidget(_strokes.addStroke(_track.mid(0, nb_removed + 1)));
+            redrawBackground(rect);
+        }
+        _track.remove(0, nb_removed);
+        redrawTrack(_live, _track, widgetRect());
+        invalidate(widgetRect());
+        return;
+    }
+
+    QRect rect = toWidget(dirty_points.boundingRect());
+    redrawTrack(_live, _track, rect);
+    invalidate(rect);
+}
+
+void TrackRasterizer::startNewTrack()
+{
+    _simplifier.reset();
+
+    if(_track.isEmpty())
+        return;
+
+    if(_persistent) {
+        QRect rect = toWidget(_strokes.addStroke(_track));
+        _track.clear();
+        redrawBackground(rect);
+        redrawTrack(_live, _track, rect);
+        invalidate(rect);
+        return;
+    }
+
+    // The current track layer becomes the old track layer
+    QRect rect = toWidget(_track.boundingRect()) | toWidget(_old_track.boundingRect());
+    _old_track.clear();
+    _track.swap(_old_track);
+    _live.swap(_fading);
+    redrawTrack(_live, _track, widgetRect());
+    _old_track_opacity = 255;
+    invalidate(rect);
+}
+
+void TrackRasterizer::setOldTrackOpacity(int alpha)
+{
+    Q_ASSERT(alpha >= 0 && alpha <= 255);
+
+    _old_track_opacity = alpha;
+    invalidate(toWidget(_old_track.boundingRect()));
+}
+
+void TrackRasterizer::erase(const QPointF& pos, qreal radius)
+{
+    QRectF erased_rect = _strokes.erase(pos, radius);
+    if(erased_rect.isNull())
+        return;
+
+    QRect rect = toWidget(erased_rect);
+    redrawBackground(rect);
+    invalidate(rect);
+}
+
+void TrackRasterizer::clearCanvas()
+{
+    _strokes.clear();
+    redrawBackground(widgetRect());
+    invalidate(widgetRect());
+}
+
+void TrackRasterizer::setTrackMaxSize(int size)
+{
+    Q_ASSERT(size > 1);
+    _max_track_size = size;
+}
+
+void TrackRasterizer::setTrackSimplifyTolerance(double tolerance)
+{
+    _simplifier.setTolerance(tolerance);
+}
+
+void TrackRasterizer::setPersistentCanvas(bool enabled)
+{
+    _persistent = enabled;
+}
+
+void TrackRasterizer::setTrackColor(const QColor& color)
+{
+    _track_color = color;
+    redrawAll();
+}
+
+void TrackRasterizer::setTrackWidth(int width)
+{
+    _track_width = width;
+    redrawAll();
+}
+
+void TrackRasterizer::setCanvasColor(const QColor& color)
+{
+    _canvas_color = color;
+    redrawBackground(widgetRect());
+    invalidate(widgetRect());
+}
+
+void TrackRasterizer::frameReleased()
+{
+    if(_render_pending && !_render_scheduled)
+        render();
+}
+
+void TrackRasterizer::render()
+{
+    _render_scheduled = false;
+
+    QImage& buffer = _buffers[_back_buffer];
+    if(buffer.isNull())
+        return;
+    // Painting a buffer still shown by the widget (or in a queued frame)
+    // would detach a full copy of it: keep the dirty rects until
+    // frameReleased().
+    _render_pending = !buffer.isDetached();
+    if(_render_pending)
+        return;
+
+    // The back buffer misses the changes of the previous frame too.
+    QRect rect = (_dirty_rect | _previous_dirty_rect) & widgetRect();
+    if(!rect.isEmpty()) {
+        QPainter painter(&buffer);
+        painter.setClipRect(rect);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.drawImage(rect, _background, rect);
+        painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+        if(_old_track_opacity > 0 && !_old_track.isEmpty()) {
+            painter.setOpacity(_old_track_opacity / 255.);
+            painter.drawImage(rect, _fading, rect);
+            painter.setOpacity(1.);
+        }
+        painter.drawImage(rect, _live, rect);
+    }
+
+    emit frameAvailable(buffer, _dirty_rect);
+
+    _previous_dirty_rect = _dirty_rect;
+    _dirty_rect = QRect();
+    _back_buffer = 1 - _back_buffer;
+}
+
+QPen TrackRasterizer::pen() const
+{
+    QPen pen(_track_color);
+    pen.setJoinStyle(Qt::RoundJoin);
+    pen.setCapStyle(Qt::RoundCap);
+    pen.setWidth(_track_width);
+    return pen;
+}
+
+QRect TrackRasterizer::toWidget(const QRectF& rect) const
+{
+    const qreal margin = _track_width / 2. + 1;
+    return _transform
+        .mapRect(rect.adjusted(-margin, -margin, margin, margin))
+        .toAlignedRect()
+        .adjusted(-1, -1, 1, 1)
+        & widgetRect();
+}
+
+QRect TrackRasterizer::widgetRect() const
+{
+    return QRect(QPoint(), _size);
+}
+
+void TrackRasterizer::redrawBackground(const QRect& rect)
+{
+    if(_background.isNull() || rect.isEmpty())
+        return;
+
+    QPainter painter(&_background);
+    painter.setClipRect(rect);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(rect, Qt::transparent);
+    if(_canvas_size.isEmpty())
+        return;
+
+    painter.setTransform(_transform);
+    painter.fillRect(QRect(QPoint(), _canvas_size), _canvas_color);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(pen());
+    _strokes.paint(painter, _transform.inverted().mapRect(QRectF(rect)));
+}
+
+void TrackRasterizer::redrawTrack(QImage& layer, const QPolygonF& track, const QRect& rect)
+{
+    if(layer.isNull() || rect.isEmpty())
+        return;
+
+    QPainter painter(&layer);
+    painter.setClipRect(rect);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(rect, Qt::transparent);
+    if(track.isEmpty())
+        return;
+
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(pen());
+    painter.setTransform(_transform);
+
+    if(track.size() == 1) {
+        painter.drawPoint(track.first());
+        return;
+    }
+
+    // Only segments in the redrawn region
+    const qreal margin = _track_width / 2. + 1;
+    const QRectF canvas_rect = _transform.inverted().mapRect(QRectF(rect))
+        .adjusted(-margin, -margin, margin, margin);
+    QVector<QLineF> lines;
+    for(int i = 1, size = track.size(); i < size; ++i) {
+        const QPointF& p0 = track[i - 1];
+        const QPointF& p1 = track[i];
+        if(qMax(p0.x(), p1.x()) < canvas_rect.left() || qMin(p0.x(), p1.x()) > canvas_rect.right() ||
+            qMax(p0.y(), p1.y()) < canvas_rect.top() || qMin(p0.y(), p1.y()) > canvas_rect.bottom())
+            continue;
+        lines.append(QLineF(p0, p1));
+    }
+    painter.drawLines(lines);
+}
+
+void TrackRasterizer::redrawAll()
+{
+    _transform = QTransform();
+    if(!_canvas_size.isEmpty() && !_size.isEmpty()) {
+        qreal scale_x = static_cast<qreal>(_size.width()) / _canvas_size.width();
+        qreal scale_y = static_cast<qreal>(_size.height()) / _canvas_size.height();
+        qreal scale = scale_x < scale_y ? scale_x : scale_y;
+
+        QPoint scaled_canvas_origin = QPoint(
+            (_size.width() - static_cast<int>(scale * _canvas_size.width())) / 2.,
+            (_size.height() - static_cast<int>(scale * _canvas_size.height())) / 2.
+        );
+        _transform.translate(scaled_canvas_origin.x(), scaled_canvas_origin.y());
+        _transform.scale(scale, scale);
+    }
+
+    redrawBackground(widgetRect());
+    redrawTrack(_live, _track, widgetRect());
+    redrawTrack(_fading, _old_track, widgetRect());
+    invalidate(widgetRect());
+    // Both buffers are outdated
+    _previous_dirty_rect = widgetRect();
+}
+
+void TrackRasterizer::invalidate(const QRect& rect)
+{
+    _dirty_rect |= rect;
+
+    if(_render_scheduled)
+        return;
+    // Render once queued updates are processed
+    _render_scheduled = true;
+    QMetaObject::invokeMethod(this, "render", Qt::QueuedConnection);
+}
+
+} // namespace laser_painter
\ No newline at end of file
@@ -0,0 +1,118 @@
+#ifndef TRACK_RASTERIZER
+#define TRACK_RASTERIZER
+
+#include <QObject>
+#include <QImage>
+#include <QPolygonF>
+#include <QTransform>
+#include <QColor>
+#include <QRect>
+#include <QSize>
+
+#include "track_simplifier.h"
+#include "stroke_canvas.h"
+
+class QPen;
+
+namespace laser_painter {
+
+/// Draw tracks of TrackWidget. Designed to run in a worker thread.
+/// Tracks are drawn incrementally into layers (background with persistent
+/// tracks, current track, fading old track) at the widget resolution. Only
+/// modified regions of layers are redrawn and composed into a pair of
+/// alternating frame buffers.
+class TrackRasterizer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TrackRasterizer(QObject* parent = 0);
+
+public slots:
+    /// Set the widget size @param size, redraw everything.
+    void resize(const QSize& size);
+    /// Set canvas size @param canvas_size, rescale persistent tracks and
+    /// remove the current and old tracks.
+    void setCanvasSize(const QSize& canvas_size);
+
+    /// Add a new tip @param pos to the current track.
+    void addTip(const QPointF& pos);
+    /// End the current track: it becomes either persistent or the old track.
+    void startNewTrack();
+    /// Set old track opacity to @param alpha in [0, 255] (0 hides it).
+    void setOldTrackOpacity(int alpha);
+    /// Erase persistent tracks passing within @param radius of @param pos.
+    void erase(const QPointF& pos, qreal radius);
+    void clearCanvas();
+
+    /// @see TrackWidget
+    void setTrackMaxSize(int size);
+    void setTrackSimplifyTolerance(double tolerance);
+    void setPersistentCanvas(bool enabled);
+    void setTrackColor(const QColor& color);
+    void setTrackWidth(int width);
+    void setCanvasColor(const QColor& color);
+
+    /// The receiver of frameAvailable() released its previous frame.
+    void frameReleased();
+
+signals:
+    /// A new frame @param frame is available, only @param dirty_rect
+    /// changed since the previous frame. The receiver should keep only the
+    /// last frame and call frameReleased() when it drops the previous one:
+    /// frames are not rendered into buffers still in use.
+    void frameAvailable(const QImage& frame, const QRect& dirty_rect) const;
+
+private slots:
+    /// Compose the dirty region of layers into the back buffer and emit it.
+    void render();
+
+private:
+    QPen pen() const;
+    // Widget rect covered by the canvas rect @param rect (with track width).
+    QRect toWidget(const QRectF& rect) const;
+    QRect widgetRect() const;
+    // Redraw @param rect of the background layer.
+    void redrawBackground(const QRect& rect);
+    // Redraw @param rect of a track layer @param layer with @param track.
+    void redrawTrack(QImage& layer, const QPolygonF& track, const QRect& rect);
+    void redrawAll();
+    // Mark @param rect as modified and schedule rendering.
+    void invalidate(const QRect& rect);
+
+private:
+    QSize _size;
+    QSize _canvas_size;
+    // From canvas to widget coordinates
+    QTransform _transform;
+
+    QPolygonF _track;
+    TrackSimplifier _simplifier;
+    int _max_track_size;
+    QPolygonF _old_track;
+    int _old_track_opacity;
+    StrokeCanvas _strokes;
+    bool _persistent;
+
+    QColor _track_color;
+    int _track_width;
+    QColor _canvas_color;
+
+    // Layers
+    QImage _background;
+    QImage _live;
+    QImage _fading;
+    // Frame buffers
+    QImage _buffers[2];
+    int _back_buffer;
+    QRect _dirty_rect;
+    // Dirty rect of the previous frame (not yet in the back buffer)
+    QRect _previous_dirty_rect;
+    bool _render_scheduled;
+    // Rendering waits for the back buffer to be released
+    bool _render_pending;
+};
+
+} // namespace laser_painter
+
+#endif // TRACK_RASTERIZER
\ No newline at end of file
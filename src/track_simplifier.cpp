@@ -0,0 +1,82 @@
+#include "track_simplifier.h"
+
+#include <QtGlobal>
+
+namespace laser_painter {
+
+TrackSimplifier::TrackSimplifier(qreal tolerance)
+    : _tolerance(tolerance),
+    _nb_vertices(0),
+    _anchor(),
+    _tip(),
+    _skipped()
+{
+    Q_ASSERT(tolerance >= 0);
+
+    _skipped.reserve(_nb_skipped_max);
+}
+
+void TrackSimplifier::reset()
+{
+    _nb_vertices = 0;
+    _skipped.clear();
+}
+
+bool TrackSimplifier::add(const QPointF& pos)
+{
+    if(_nb_vertices == 0) {
+        _anchor = pos;
+        ++_nb_vertices;
+        return true;
+    }
+    if(_nb_vertices == 1) {
+        _tip = pos;
+        ++_nb_vertices;
+        return true;
+    }
+
+    if(_tolerance > 0 && _skipped.size() < _nb_skipped_max && fits(pos)) {
+        // Move the floating vertex
+        _skipped.append(_tip);
+        _tip = pos;
+        return false;
+    }
+
+    // Fix the floating vertex and start a new one
+    _anchor = _tip;
+    _tip = pos;
+    _skipped.clear();
+    return true;
+}
+
+void TrackSimplifier::setTolerance(qreal tolerance)
+{
+    Q_ASSERT(tolerance >= 0);
+
+    _tolerance = tolerance;
+    _skipped.clear();
+}
+
+bool TrackSimplifier::fits(const QPointF& pos) const
+{
+    const qreal tolerance2 = _tolerance * _tolerance;
+
+    if(distance2ToSegment(_tip, _anchor, pos) > tolerance2)
+        return false;
+    for(int i = 0, size = _skipped.size(); i < size; ++i)
+        if(distance2ToSegment(_skipped[i], _anchor, pos) > tolerance2)
+            return false;
+    return true;
+}
+
+qreal TrackSimplifier::distance2ToSegment(const QPointF& p, const QPointF& a, const QPointF& b)
+{
+    QPointF ab = b - a;
+    QPointF ap = p - a;
+    qreal ab2 = QPointF::dotProduct(ab, ab);
+    qreal t = ab2 > 0 ? qBound<qreal>(0, QPointF::dotProduct(ap, ab) / ab2, 1) : 0;
+    QPointF e = ap - t * ab;
+    return QPointF::dotProduct(e, e);
+}
+
+} // namespace laser_painter
\ No newline at end of file
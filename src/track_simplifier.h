@@ -0,0 +1,55 @@
+#ifndef TRACK_SIMPLIFIER
+#define TRACK_SIMPLIFIER
+
+#include <QPointF>
+#include <QVector>
+
+namespace laser_painter {
+
+/// Online polyline simplification of a track.
+/// The last vertex of the track is "floating": it follows new tips as long as
+/// all the tips skipped since the previous vertex stay within a tolerance of
+/// the segment (previous vertex, new tip). Otherwise it's fixed and a new
+/// vertex is started.
+class TrackSimplifier
+{
+public:
+    /// @param tolerance maximal distance (in pixels >= 0) between the skipped
+    /// tips and the simplified track. If zero, no simplification is performed.
+    explicit TrackSimplifier(qreal tolerance = 0);
+
+    /// Forget the current track.
+    void reset();
+
+    /// Feed a new tip @param pos.
+    /// @return true if @param pos should be appended to the track as a new
+    /// vertex, false if it should replace the last vertex of the track.
+    bool add(const QPointF& pos);
+
+    /// @see TrackSimplifier()
+    void setTolerance(qreal tolerance);
+
+private:
+    // Check if all the skipped tips (and the floating vertex) are close to
+    // the segment (_anchor, pos).
+    bool fits(const QPointF& pos) const;
+    // Squared distance from @param p to the segment (@param a, @param b).
+    static inline qreal distance2ToSegment(const QPointF& p, const QPointF& a, const QPointF& b);
+
+private:
+    qreal _tolerance;
+    // Number of vertices of the current track (saturated to 2).
+    int _nb_vertices;
+    // Last fixed vertex
+    QPointF _anchor;
+    // Last (floating) vertex
+    QPointF _tip;
+    // Tips replaced by the floating vertex since _anchor.
+    QVector<QPointF> _skipped;
+    // Bound the cost of fits().
+    static const int _nb_skipped_max = 64;
+};
+
+} // namespace laser_painter
+
+#endif // TRACK_SIMPLIFIER
\ No newline at end of file
@@ -5,6 +5,12 @@
 #include <QSize>
 #include <QTimer>
 #include <QColor>
+#include <QThread>
+#include <QPaintEvent>
+#include <QResizeEvent>
+#include <QMetaObject>
+
+#include "track_rasterizer.h"
 
 namespace laser_painter {
 
@@ -17,20 +23,32 @@ TrackWidget::TrackWidget
     Qt::WindowFlags flags
 )
     : QWidget(parent, flags),
-    _track(),
-    _max_track_size(max_track_size),
+    _frame(),
+    _has_track(false),
     _max_delay(max_delay * 1000),
     _canvas_size(canvas_size),
     _track_color(Qt::magenta),
     _track_width(3),
     _canvas_color(Qt::black),
-    _old_track(),
+    _persistent(false),
+    _eraser(false),
     _show_old_track(false),
     _old_track_opacity(255)
 {
     Q_ASSERT(max_track_size > 0);
     Q_ASSERT(max_delay >= 0);
 
+    _rasterizer_thread = new QThread(this);
+    _rasterizer = new TrackRasterizer();
+    _rasterizer->moveToThread(_rasterizer_thread);
+    connect(_rasterizer_thread, &QThread::finished, _rasterizer, &QObject::deleteLater);
+    connect(_rasterizer, &TrackRasterizer::frameAvailable, this, &TrackWidget::setFrame);
+    _rasterizer_thread->start();
+
+    // Calls of the rasterizer are queued (it lives in another thread).
+    QMetaObject::invokeMethod(_rasterizer, "setTrackMaxSize", Q_ARG(int, max_track_size));
+    QMetaObject::invokeMethod(_rasterizer, "setCanvasSize", Q_ARG(QSize, _canvas_size));
+
     _fade_timer = new QTimer(this);
     _fade_timer->setInterval(_fade_timer_interval);
     connect(_fade_timer, &QTimer::timeout, this, &TrackWidget::updateOldTrackOpacity);
@@ -42,10 +60,35 @@ TrackWidget::TrackWidget
     _max_delay_timer->start();
 }
 
+TrackWidget::~TrackWidget()
+{
+    _rasterizer_thread->quit();
+    _rasterizer_thread->wait();
+}
+
+const QColor& TrackWidget::trackColor() const
+{
+    return _track_color;
+}
+
+int TrackWidget::trackWidth() const
+{
+    return _track_width;
+}
+
+const QColor& TrackWidget::canvasColor() const
+{
+    return _canvas_color;
+}
+
 void TrackWidget::addTip(const QPointF& pos, bool found)
 {
-    if(found) {
-        addTip(pos);
+    if(found && _eraser) {
+        QMetaObject::invokeMethod(_rasterizer, "erase", Q_ARG(QPointF, pos), Q_ARG(qreal, _track_width));
+    } else if(found) {
+        QMetaObject::invokeMethod(_rasterizer, "addTip", Q_ARG(QPointF, pos));
+        _has_track = true;
+        emit tipAdded(pos);
         // Restart delay timer
         _max_delay_timer->start();
     }
@@ -55,34 +98,29 @@ void TrackWidget::startNewTrack()
 {
     _max_delay_timer->start();
 
-    if(_track.isEmpty())
-        return;
+    if(_has_track) {
+        emit trackEnded();
 
-    if(_show_old_track)
-        stopShowOldTrack();
+        if(!_persistent) {
+            if(_show_old_track)
+                stopShowOldTrack();
+            _show_old_track = true;
+            _fade_timer->start();
+        }
+    }
 
-    _old_track.clear();
-    _track.swap(_old_track);
-    _show_old_track = true;
-    _fade_timer->start();
-    repaint();
-}
-
-void TrackWidget::addTip(const QPointF& pos)
-{
-    _track.append(pos);
-    if(_track.size() > _max_track_size)
-        // Remove 5% of track
-        _track.remove(0, _track.size() - _max_track_size
-            + static_cast<size_t>(0.05 * _max_track_size));
-    repaint();
+    // Also resets the track simplification if the track is empty.
+    QMetaObject::invokeMethod(_rasterizer, "startNewTrack");
+    _has_track = false;
 }
 
 void TrackWidget::setCanvasSize(const QSize& canvas_size)
 {
     _canvas_size = canvas_size;
-    _track.clear(); // prevent painting irrelevant old track after rescaling
-    repaint();
+    QMetaObject::invokeMethod(_rasterizer, "setCanvasSize", Q_ARG(QSize, canvas_size));
+    _has_track = false;
+    if(_show_old_track)
+        stopShowOldTrack();
     startNewTrack();
 }
 
@@ -97,78 +135,91 @@ void TrackWidget::setTrackMaxDelay(double delay)
 void TrackWidget::setTrackMaxSize(int size)
 {
     Q_ASSERT(size > 1);
-    _max_track_size = size;
+    QMetaObject::invokeMethod(_rasterizer, "setTrackMaxSize", Q_ARG(int, size));
+}
+
+void TrackWidget::setTrackSimplifyTolerance(double tolerance)
+{
+    Q_ASSERT(tolerance >= 0);
+    QMetaObject::invokeMethod(_rasterizer, "setTrackSimplifyTolerance", Q_ARG(double, tolerance));
 }
 
 void TrackWidget::setTrackColor(const QColor& color)
 {
     Q_ASSERT(color.isValid());
     _track_color = color;
+    QMetaObject::invokeMethod(_rasterizer, "setTrackColor", Q_ARG(QColor, color));
 }
 
 void TrackWidget::setTrackWidth(int halfwidth)
 {
     Q_ASSERT(halfwidth > 0);
     _track_width = 2 * halfwidth - 1;
+    QMetaObject::invokeMethod(_rasterizer, "setTrackWidth", Q_ARG(int, _track_width));
 }
 
 void TrackWidget::setCanvasColor(const QColor& color)
 {
     Q_ASSERT(color.isValid());
     _canvas_color = color;
+    QMetaObject::invokeMethod(_rasterizer, "setCanvasColor", Q_ARG(QColor, color));
 }
 
-void TrackWidget::paintEvent(QPaintEvent* event)
+void TrackWidget::setPersistentCanvas(bool enabled)
 {
-    Q_UNUSED(event);
+    _persistent = enabled;
+    QMetaObject::invokeMethod(_rasterizer, "setPersistentCanvas", Q_ARG(bool, enabled));
+}
 
-    if(_canvas_size.isEmpty())
-        return;
+void TrackWidget::setEraser(bool enabled)
+{
+    if(enabled)
+        // Keep the drawn part of the track
+        startNewTrack();
+    _eraser = enabled;
+}
 
-    qreal scale_x = static_cast<qreal>(width()) / _canvas_size.width();
-    qreal scale_y = static_cast<qreal>(height()) / _canvas_size.height();
-    qreal scale = scale_x < scale_y ? scale_x : scale_y;
+void TrackWidget::clearCanvas()
+{
+    QMetaObject::invokeMethod(_rasterizer, "clearCanvas");
+}
 
-    QSize scaled_canvas_size = QSize(
-        scale * _canvas_size.width(),
-        scale * _canvas_size.height()
-    );
-    QPoint scaled_canvas_origin = QPoint(
-        (width() - scaled_canvas_size.width()) / 2.,
-        (height() - scaled_canvas_size.height()) / 2.
-    );
+void TrackWidget::paintEvent(QPaintEvent* event)
+{
+    if(_frame.isNull())
+        return;
 
-    // Draw canvas
+    // Tracks are already drawn, just blit.
     QPainter painter(this);
-    painter.setBrush(QBrush(_canvas_color));
-    painter.drawRect(QRect(scaled_canvas_origin, scaled_canvas_size));
-
-    // Draw track
-    painter.setRenderHint(QPainter::Antialiasing);
-    QPen pen(_track_color);
-    pen.setJoinStyle(Qt::RoundJoin);
-    pen.setCapStyle(Qt::RoundCap);
-    pen.setWidth(_track_width);
-    painter.setPen(pen);
-    painter.translate(scaled_canvas_origin);
-    painter.scale(scale, scale);
-    painter.drawPolyline(_track);
-
-    if(_show_old_track) {
-        QColor pen_color = pen.color();
-        pen_color.setAlpha(_old_track_opacity);
-        pen.setColor(pen_color);
-        painter.setPen(pen);
-        painter.drawPolyline(_old_track);
-    }
+    QRect rect = event->rect() & _frame.rect();
+    painter.drawImage(rect, _frame, rect);
+}
+
+void TrackWidget::resizeEvent(QResizeEvent* event)
+{
+    QMetaObject::invokeMethod(_rasterizer, "resize", Q_ARG(QSize, event->size()));
+}
+
+void TrackWidget::setFrame(const QImage& frame, const QRect& dirty_rect)
+{
+    bool resized = frame.size() != _frame.size();
+    _frame = frame;
+    // The previous frame buffer can be reused.
+    QMetaObject::invokeMethod(_rasterizer, "frameReleased");
+    if(resized)
+        update();
+    else
+        update(dirty_rect);
 }
 
 void TrackWidget::updateOldTrackOpacity()
 {
-    if(_old_track_opacity <= _fade_opacity_step)
+    if(_old_track_opacity <= _fade_opacity_step) {
         stopShowOldTrack();
+        return;
+    }
     _old_track_opacity -= _fade_opacity_step;
-    repaint();
+    QMetaObject::invokeMethod(_rasterizer, "setOldTrackOpacity", Q_ARG(int, _old_track_opacity));
 }
 
 void TrackWidget::stopShowOldTrack()
@@ -176,6 +227,7 @@ void TrackWidget::stopShowOldTrack()
     _old_track_opacity = 255;
     _fade_timer->stop();
     _show_old_track = false;
+    QMetaObject::invokeMethod(_rasterizer, "setOldTrackOpacity", Q_ARG(int, 0));
 }
 
 } // namespace laser_painter
\ No newline at end of file
@@ -2,14 +2,20 @@
 #define TRACK_WIDGET
 
 #include <QWidget>
-#include <QPolygonF>
+#include <QImage>
 #include <QSize>
 #include <QRect>
 
 class QPaintEvent;
+class QResizeEvent;
 class QPointF;
 class QTimer;
 class QColor;
+class QThread;
+
+namespace laser_painter {
+    class TrackRasterizer;
+}
 
 namespace laser_painter {
 
@@ -32,6 +38,12 @@ public:
         QWidget* parent = 0,
         Qt::WindowFlags flags = 0
     );
+    ~TrackWidget();
+
+    const QColor& trackColor() const;
+    /// Track (pen) width in canvas pixels
+    int trackWidth() const;
+    const QColor& canvasColor() const;
 
 public slots:
     /// Add a new tip position @param pos to the track.
@@ -46,28 +58,48 @@ public slots:
     /// @see TrackWidget()
     /// @param size >= 2 (two points = 1 segmant)
     void setTrackMaxSize(int size);
+    /// Set the tolerance (in canvas pixels >= 0) of the track simplification.
+    /// Tips closer than @param tolerance to the simplified track don't add new
+    /// track points. If zero, all tips are kept.
+    void setTrackSimplifyTolerance(double tolerance);
 
     void setTrackColor(const QColor& color);
     void setTrackWidth(int halfwidth);
     void setCanvasColor(const QColor& color);
 
+    /// End the current track and start a new empty one.
+    void startNewTrack();
+
+    /// If @param enabled, ended tracks stay on the canvas instead of fading.
+    void setPersistentCanvas(bool enabled);
+    /// If @param enabled, tips erase persistent tracks instead of drawing.
+    void setEraser(bool enabled);
+    /// Remove all persistent tracks.
+    void clearCanvas();
+
+signals:
+    /// A new tip @param pos was added to the current track.
+    void tipAdded(const QPointF& pos) const;
+    /// The current track is ended.
+    void trackEnded() const;
+
 protected:
     void paintEvent(QPaintEvent* event);
-
-private:
-    /// Add a new tip to the current track.
-    void addTip(const QPointF& pos);
+    void resizeEvent(QResizeEvent* event);
 
 private slots:
-    /// End the current track and start a new empty one.
-    void startNewTrack();
     void updateOldTrackOpacity();
     void stopShowOldTrack();
+    /// Show a new rasterized frame @param frame.
+    void setFrame(const QImage& frame, const QRect& dirty_rect);
 
 private:
-    // TODO: change to std::deque in the case of performance problems
-    QPolygonF _track;
-    int _max_track_size;
+    // Tracks are drawn in a worker thread, the widget only shows frames.
+    QThread* _rasterizer_thread;
+    TrackRasterizer* _rasterizer;
+    QImage _frame;
+    // Current track has tips
+    bool _has_track;
     // maximum delay.
     uint _max_delay;
     QSize _canvas_size;
@@ -76,9 +108,11 @@ private:
     uint _track_width;
     QColor _canvas_color;
 
+    bool _persistent;
+    bool _eraser;
+
     QTimer* _fade_timer;
     QTimer* _max_delay_timer;
-    QPolygonF _old_track;
     bool _show_old_track;
     uchar _old_track_opacity;
     static const int _fade_animation_time = 1024 * 1; // milliseconds
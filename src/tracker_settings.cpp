@@ -3,6 +3,7 @@
 #include <QSettings>
 #include <QPushButton>
 #include <QSpinBox>
+#include <QCheckBox>
 #include <QColorDialog>
 #include <QVBoxLayout>
 #include <QLabel>
@@ -39,6 +40,32 @@ TrackerSettings::TrackerSettings(TrackWidget* track_widget, QWidget* parent):
     max_delay_lb->setToolTip("A new track begins after the delay has elapsed");
     max_delay_lb->setBuddy(_max_delay_sb);
 
+    _simplify_tolerance_sb = new QDoubleSpinBox();
+    _simplify_tolerance_sb->setRange(0., 9.9);
+    _simplify_tolerance_sb->setDecimals(1);
+    _simplify_tolerance_sb->setSingleStep(.1);
+    _simplify_tolerance_sb->setSuffix(tr(" px"));
+    connect(_simplify_tolerance_sb, SIGNAL(valueChanged(double)), track_widget, SLOT(setTrackSimplifyTolerance(double)));
+    _simplify_tolerance_sb->setValue(settings.value("TrackerSettings/simplify_tolerance", .5).toDouble());
+    QLabel* simplify_tolerance_lb = new QLabel(tr("Simplification:"));
+    simplify_tolerance_lb->setToolTip("Tips closer than this distance to the track\ndon't add new track points (0 keeps all tips)");
+    simplify_tolerance_lb->setBuddy(_simplify_tolerance_sb);
+    _persistent_cb = new QCheckBox();
+    connect(_persistent_cb, &QCheckBox::toggled, track_widget, &TrackWidget::setPersistentCanvas);
+    _persistent_cb->setChecked(settings.value("TrackerSettings/persistent", false).toBool());
+    QLabel* persistent_lb = new QLabel(tr("Keep tracks:"));
+    persistent_lb->setToolTip("Ended tracks stay on the canvas instead of fading");
+    persistent_lb->setBuddy(_persistent_cb);
+
+    _eraser_cb = new QCheckBox();
+    connect(_eraser_cb, &QCheckBox::toggled, track_widget, &TrackWidget::setEraser);
+    QLabel* eraser_lb = new QLabel(tr("Eraser:"));
+    eraser_lb->setToolTip("Laser erases kept tracks instead of drawing");
+    eraser_lb->setBuddy(_eraser_cb);
+
+    QPushButton* clear_canvas_bn = new QPushButton(tr("Clear"));
+    clear_canvas_bn->setToolTip("Remove kept tracks");
+    connect(clear_canvas_bn, &QPushButton::clicked, track_widget, &TrackWidget::clearCanvas);
 
     _track_color_bn = new QPushButton();
     _track_color_bn->setMaximumHeight(24);
@@ -83,6 +110,19 @@ TrackerSettings::TrackerSettings(TrackWidget* track_widget, QWidget* parent):
     max_track_size_lo->addWidget(max_track_size_lb);
     max_track_size_lo->addWidget(_max_track_size_sb);
 
+    QHBoxLayout* simplify_tolerance_lo = new QHBoxLayout();
+    simplify_tolerance_lo->addStretch();
+    simplify_tolerance_lo->addWidget(simplify_tolerance_lb);
+    simplify_tolerance_lo->addWidget(_simplify_tolerance_sb);
+
+    QHBoxLayout* persistent_lo = new QHBoxLayout();
+    persistent_lo->addStretch();
+    persistent_lo->addWidget(persistent_lb);
+    persistent_lo->addWidget(_persistent_cb);
+    persistent_lo->addWidget(eraser_lb);
+    persistent_lo->addWidget(_eraser_cb);
+    persistent_lo->addWidget(clear_canvas_bn);
+
     QHBoxLayout* track_color_lo = new QHBoxLayout();
     track_color_lo->addStretch();
     track_color_lo->addWidget(track_color_lb);
@@ -101,6 +141,8 @@ TrackerSettings::TrackerSettings(TrackWidget* track_widget, QWidget* parent):
     QVBoxLayout* main_lo = new QVBoxLayout();
     main_lo->addLayout(max_delay_lo);
     main_lo->addLayout(max_track_size_lo);
+    main_lo->addLayout(simplify_tolerance_lo);
+    main_lo->addLayout(persistent_lo);
     main_lo->addLayout(track_width_lo);
     main_lo->addLayout(track_color_lo);
     main_lo->addLayout(canvas_color_lo);
@@ -154,6 +196,8 @@ void TrackerSettings::writeSettings() const
 
     settings.setValue("max_delay", _max_delay_sb->value());
     settings.setValue("max_track_size", _max_track_size_sb->value());
+    settings.setValue("simplify_tolerance", _simplify_tolerance_sb->value());
+    settings.setValue("persistent", _persistent_cb->isChecked());
 
     settings.endGroup();
 }
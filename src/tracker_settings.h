@@ -7,6 +7,7 @@
 class QPushButton;
 class QSpinBox;
 class QDoubleSpinBox;
+class QCheckBox;
 
 namespace laser_painter {
     class TrackWidget;
@@ -40,8 +41,12 @@ signals:
 private:
     QSpinBox* _max_track_size_sb;
     QDoubleSpinBox* _max_delay_sb;
+    QDoubleSpinBox* _simplify_tolerance_sb;
     QSpinBox* _track_width_sb;
 
+    QCheckBox* _persistent_cb;
+    QCheckBox* _eraser_cb;
+
     QPushButton* _track_color_bn;
     QPushButton* _canvas_color_bn;
     // TODO: No idea how to easily get a background color from a button style sheet.
@@ -1,6 +1,18 @@
 #include "video_frame_grabber.h"
 
 #include <QCamera>
+#include <QBuffer>
+#include <QImageReader>
+#include <QElapsedTimer>
+#include <cstring>
+#include <cstdio>
+#include <csetjmp>
+
+#ifdef HAVE_JPEG
+extern "C" {
+#include <jpeglib.h>
+}
+#endif
 
 #include "opencv2/core/core.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
@@ -9,8 +21,8 @@ namespace laser_painter {
 
 VideoFrameGrabber::VideoFrameGrabber(QObject *parent) :
     QAbstractVideoSurface(parent),
-    _flip_x(false),
-    _flip_y(false)
+    _jpeg_scale_denom(1),
+    _frame_scale(1.)
 {}
 
 QList<QVideoFrame::PixelFormat> VideoFrameGrabber::supportedPixelFormats(QAbstractVideoBuffer::HandleType handleType) const
@@ -53,6 +65,11 @@ QList<QVideoFrame::PixelFormat> VideoFrameGrabber::supportedPixelFormats(QAbstra
 
 bool VideoFrameGrabber::present(const QVideoFrame& frame)
 {
+    // Closest time to the capture we know, before mapping and conversion
+    QElapsedTimer clock;
+    clock.start();
+    const qint64 capture_time = clock.msecsSinceReference();
+
     if (!frame.isValid()) {
         emit frameAvailable(QImage());
         return false;
@@ -65,13 +82,28 @@ bool VideoFrameGrabber::present(const QVideoFrame& frame)
     QVideoFrame::PixelFormat frame_pixel_format = frame_shallow_copy.pixelFormat();
     QImage frame_image;
     if(
+        frame_pixel_format == QVideoFrame::Format_AYUV444 ||
+        frame_pixel_format == QVideoFrame::Format_AYUV444_Premultiplied ||
         frame_pixel_format == QVideoFrame::Format_YUV444 ||
         frame_pixel_format == QVideoFrame::Format_YUV420P ||
         frame_pixel_format == QVideoFrame::Format_YV12 ||
         frame_pixel_format == QVideoFrame::Format_UYVY ||
-        frame_pixel_format == QVideoFrame::Format_YUYV
+        frame_pixel_format == QVideoFrame::Format_YUYV ||
+        frame_pixel_format == QVideoFrame::Format_NV12 ||
+        frame_pixel_format == QVideoFrame::Format_NV21 ||
+        frame_pixel_format == QVideoFrame::Format_IMC1 ||
+        frame_pixel_format == QVideoFrame::Format_IMC2 ||
+        frame_pixel_format == QVideoFrame::Format_IMC3 ||
+        frame_pixel_format == QVideoFrame::Format_IMC4
     )
         frame_image = YUVQVideoFrame2QImage(frame_shallow_copy);
+    else if(frame_pixel_format == QVideoFrame::Format_Jpeg)
+        frame_image = JpegQVideoFrame2QImage(frame_shallow_copy);
+    else if(
+        frame_pixel_format == QVideoFrame::Format_Y8 ||
+        frame_pixel_format == QVideoFrame::Format_Y16
+    )
+        frame_image = YQVideoFrame2QImage(frame_shallow_copy);
     else
         frame_image = QImage(
             frame_shallow_copy.bits(),
@@ -81,7 +113,10 @@ bool VideoFrameGrabber::present(const QVideoFrame& frame)
             // Warning: QImage::Format_Invalid will be returned for unsupported.
             QVideoFrame::imageFormatFromPixelFormat(frame_shallow_copy.pixelFormat())
         );
-    emit frameAvailable(_flip_x || _flip_y ? frame_image.mirrored(_flip_x, _flip_y) : frame_image);
+    if(frame_pixel_format != QVideoFrame::Format_Jpeg)
+        updateFrameScale(1.);
+    emit frameCaptured(capture_time);
+    emit frameAvailable(frame_image);
 
     // Unmap from CPU
     frame_shallow_copy.unmap();
@@ -97,28 +132,82 @@ void VideoFrameGrabber::installCamera(QCamera* camera)
     camera->start();
 }
 
-void VideoFrameGrabber::setFlipX(bool enabled)
+void VideoFrameGrabber::setDecodeScale(qreal scale)
 {
-    _flip_x = enabled;
+    Q_ASSERT(scale > 0 && scale <= 1.);
+    // Largest supported denominator keeping the decoded frame at least as
+    // large as the scaled one
+    _jpeg_scale_denom = 1;
+    while(_jpeg_scale_denom < 8 && 1. / (_jpeg_scale_denom * 2) >= scale - 1e-6)
+        _jpeg_scale_denom *= 2;
 }
 
-void VideoFrameGrabber::setFlipY(bool enabled)
+void VideoFrameGrabber::updateFrameScale(qreal scale)
 {
-    _flip_y = enabled;
+    if(scale == _frame_scale)
+        return;
+    _frame_scale = scale;
+    emit frameScaleChanged(_frame_scale);
 }
 
-QImage VideoFrameGrabber::YUVQVideoFrame2QImage(const QVideoFrame& frame) const
+QImage& VideoFrameGrabber::rgbBuffer(const QSize& size)
 {
+    // Receivers usually don't keep the frame after frameAvailable() is
+    // handled, the buffer can then be reused for the next frame.
+    if(_rgb_buffer.size() != size || !_rgb_buffer.isDetached())
+        _rgb_buffer = QImage(size, QImage::Format_RGB888);
+    return _rgb_buffer;
+}
+
+uchar* VideoFrameGrabber::stagingBuffer(int size)
+{
+    if(_yuv_staging.size() < size)
+        _yuv_staging.resize(size);
+    return (uchar*) _yuv_staging.data();
+}
+
+// Copy @param nb_rows rows of @param row_size bytes from @param src (with
+// @param src_step bytes per line) to @param dst (contiguous rows).
+static inline void copyRows(const uchar* src, int src_step, uchar* dst, int row_size, int nb_rows)
+{
+    if(src_step == row_size) {
+        std::memcpy(dst, src, row_size * nb_rows);
+        return;
+    }
+    for(int i = 0; i < nb_rows; ++i, src += src_step, dst += row_size)
+        std::memcpy(dst, src, row_size);
+}
+
+QImage VideoFrameGrabber::YUVQVideoFrame2QImage(const QVideoFrame& frame)
+{
+    const int width = frame.width();
+    const int height = frame.height();
+    const QVideoFrame::PixelFormat pixel_format = frame.pixelFormat();
+    const bool subsampled =
+        pixel_format != QVideoFrame::Format_AYUV444 &&
+        pixel_format != QVideoFrame::Format_AYUV444_Premultiplied &&
+        pixel_format != QVideoFrame::Format_YUV444;
+    if(width <= 0 || height <= 0 || (subsampled && (width % 2 || height % 2))) {
+        emit warning("Camera frame size is not supported");
+        return QImage();
+    }
+
+    // Source planes
+    const uchar* y_plane = frame.bits(0);
+    const int y_step = frame.bytesPerLine(0);
+    // Chroma planes, u_plane is the interleaved UV (or VU) plane of
+    // semi-planar formats.
+    const uchar* u_plane = 0;
+    const uchar* v_plane = 0;
+    int u_step = 0;
+    int v_step = 0;
+    int nb_planes = 1;
     /*cv::ColorConversionCodes*/ int cv_color_conversion_code;
-    switch(frame.pixelFormat()) {
+    switch(pixel_format) {
+    case QVideoFrame::Format_AYUV444:
+    case QVideoFrame::Format_AYUV444_Premultiplied:
     case QVideoFrame::Format_YUV444:
-        cv_color_conversion_code = cv::COLOR_YCrCb2RGB;
-        break;
-    case QVideoFrame::Format_YUV420P:
-        cv_color_conversion_code = cv::COLOR_YUV2RGB_I420 ;
-        break;
-    case QVideoFrame::Format_YV12:
-        cv_color_conversion_code = cv::COLOR_YUV2RGB_YV12;
+        cv_color_conversion_code = cv::COLOR_YUV2RGB;
         break;
     case QVideoFrame::Format_UYVY:
         cv_color_conversion_code = cv::COLOR_YUV2RGB_UYVY;
@@ -126,15 +215,223 @@ QImage VideoFrameGrabber::YUVQVideoFrame2QImage(const QVideoFrame& frame) const
     case QVideoFrame::Format_YUYV:
         cv_color_conversion_code = cv::COLOR_YUV2RGB_YUYV;
         break;
+    case QVideoFrame::Format_NV12:
+    case QVideoFrame::Format_NV21:
+        cv_color_conversion_code = pixel_format == QVideoFrame::Format_NV12 ?
+            cv::COLOR_YUV2RGB_NV12 :
+            cv::COLOR_YUV2RGB_NV21;
+        nb_planes = 2;
+        u_plane = frame.bits(1);
+        u_step = frame.bytesPerLine(1);
+        break;
+    case QVideoFrame::Format_YUV420P:
+    case QVideoFrame::Format_IMC3:
+        // U plane, then V plane
+        cv_color_conversion_code = cv::COLOR_YUV2RGB_I420;
+        nb_planes = 3;
+        u_plane = frame.bits(1);
+        u_step = frame.bytesPerLine(1);
+        v_plane = frame.bits(2);
+        v_step = frame.bytesPerLine(2);
+        break;
+    case QVideoFrame::Format_YV12:
+    case QVideoFrame::Format_IMC1:
+        // V plane, then U plane
+        cv_color_conversion_code = cv::COLOR_YUV2RGB_I420;
+        nb_planes = 3;
+        v_plane = frame.bits(1);
+        v_step = frame.bytesPerLine(1);
+        u_plane = frame.bits(2);
+        u_step = frame.bytesPerLine(2);
+        break;
+    case QVideoFrame::Format_IMC2:
+    case QVideoFrame::Format_IMC4:
+        // Each chroma line holds half a line of V then half a line of U
+        // (IMC2), or U then V (IMC4).
+        cv_color_conversion_code = cv::COLOR_YUV2RGB_I420;
+        nb_planes = 2;
+        u_step = v_step = frame.bytesPerLine(1);
+        u_plane = v_plane = frame.bits(1);
+        if(pixel_format == QVideoFrame::Format_IMC2)
+            u_plane += u_step / 2;
+        else
+            v_plane += v_step / 2;
+        break;
     default:
         emit warning("Camera color space format is not supported");
         return QImage();
     }
+    if(frame.planeCount() < nb_planes || !y_plane) {
+        emit warning("Camera frame planes are missing");
+        return QImage();
+    }
 
-    cv::Mat yuv_mat(frame.height(), frame.width(), CV_8UC3, (void*) frame.bits(), frame.bytesPerLine());
-    cv::Mat rgb_mat;
+    // Source mat in a layout understood by opencv
+    cv::Mat yuv_mat;
+    switch(pixel_format) {
+    case QVideoFrame::Format_AYUV444:
+    case QVideoFrame::Format_AYUV444_Premultiplied:
+    {
+        // Drop alpha
+        cv::Mat ayuv_mat(height, width, CV_8UC4, (void*) y_plane, y_step);
+        yuv_mat = cv::Mat(height, width, CV_8UC3, stagingBuffer(height * width * 3));
+        const int from_to[] = {1, 0, 2, 1, 3, 2};
+        cv::mixChannels(&ayuv_mat, 1, &yuv_mat, 1, from_to, 3);
+        break;
+    }
+    case QVideoFrame::Format_YUV444:
+        yuv_mat = cv::Mat(height, width, CV_8UC3, (void*) y_plane, y_step);
+        break;
+    case QVideoFrame::Format_UYVY:
+    case QVideoFrame::Format_YUYV:
+        // 2 bytes per pixel, any line step is fine
+        yuv_mat = cv::Mat(height, width, CV_8UC2, (void*) y_plane, y_step);
+        break;
+    case QVideoFrame::Format_NV12:
+    case QVideoFrame::Format_NV21:
+        // opencv expects the chroma plane right after the luma plane, with
+        // the same step.
+        if(u_plane == y_plane + y_step * height && u_step == y_step)
+            yuv_mat = cv::Mat(height * 3 / 2, width, CV_8UC1, (void*) y_plane, y_step);
+        else {
+            uchar* staging = stagingBuffer(width * height * 3 / 2);
+            copyRows(y_plane, y_step, staging, width, height);
+            copyRows(u_plane, u_step, staging + width * height, width, height / 2);
+            yuv_mat = cv::Mat(height * 3 / 2, width, CV_8UC1, staging);
+        }
+        break;
+    default:
+        // Planar 4:2:0, opencv expects both chroma planes right after the
+        // luma plane, with half the luma step.
+        if(2 * u_step == y_step && v_step == u_step) {
+            const uchar* chroma_plane = y_plane + y_step * height;
+            const int chroma_plane_size = u_step * (height / 2);
+            if(u_plane == chroma_plane && v_plane == chroma_plane + chroma_plane_size) {
+                yuv_mat = cv::Mat(height * 3 / 2, width, CV_8UC1, (void*) y_plane, y_step);
+                break;
+            }
+            if(v_plane == chroma_plane && u_plane == chroma_plane + chroma_plane_size) {
+                yuv_mat = cv::Mat(height * 3 / 2, width, CV_8UC1, (void*) y_plane, y_step);
+                cv_color_conversion_code = cv::COLOR_YUV2RGB_YV12;
+                break;
+            }
+        }
+        // Otherwise copy planes into a contiguous I420 buffer
+        {
+            const int chroma_size = (width / 2) * (height / 2);
+            uchar* staging = stagingBuffer(width * height + 2 * chroma_size);
+            copyRows(y_plane, y_step, staging, width, height);
+            copyRows(u_plane, u_step, staging + width * height, width / 2, height / 2);
+            copyRows(v_plane, v_step, staging + width * height + chroma_size, width / 2, height / 2);
+            yuv_mat = cv::Mat(height * 3 / 2, width, CV_8UC1, staging);
+        }
+        break;
+    }
+
+    // Convert directly into the output image
+    QImage& rgb_image = rgbBuffer(QSize(width, height));
+    cv::Mat rgb_mat(height, width, CV_8UC3, rgb_image.bits(), rgb_image.bytesPerLine());
     cv::cvtColor(yuv_mat, rgb_mat, cv_color_conversion_code);
-    return QImage((uchar*) rgb_mat.data, rgb_mat.cols, rgb_mat.rows, rgb_mat.step, QImage::Format_RGB888);
+    return rgb_image;
+}
+
+QImage VideoFrameGrabber::YQVideoFrame2QImage(const QVideoFrame& frame)
+{
+    if(frame.pixelFormat() == QVideoFrame::Format_Y8)
+        return QImage(frame.bits(), frame.width(), frame.height(), frame.bytesPerLine(), QImage::Format_Grayscale8);
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    // Keep the full bit depth
+    return QImage(frame.bits(), frame.width(), frame.height(), frame.bytesPerLine(), QImage::Format_Grayscale16);
+#else
+    // No 16-bit grayscale images, keep the most significant byte
+    QImage image(frame.width(), frame.height(), QImage::Format_Grayscale8);
+    cv::Mat y16_mat(frame.height(), frame.width(), CV_16UC1, (void*) frame.bits(), frame.bytesPerLine());
+    cv::Mat y8_mat(image.height(), image.width(), CV_8UC1, image.bits(), image.bytesPerLine());
+    y16_mat.convertTo(y8_mat, CV_8U, 1. / 256);
+    return image;
+#endif
+}
+
+#ifdef HAVE_JPEG
+namespace {
+
+// libjpeg error manager which returns to decodeJpeg() instead of exiting
+struct JpegErrorManager {
+    jpeg_error_mgr base;
+    std::jmp_buf jump_buffer;
+};
+
+void jpegErrorExit(j_common_ptr cinfo)
+{
+    std::longjmp(reinterpret_cast<JpegErrorManager*>(cinfo->err)->jump_buffer, 1);
+}
+
+void jpegOutputMessage(j_common_ptr)
+{}
+
+} // namespace
+#endif
+
+QImage VideoFrameGrabber::JpegQVideoFrame2QImage(const QVideoFrame& frame)
+{
+    const uchar* data = frame.bits();
+    const int size = frame.mappedBytes();
+    if(!data || size <= 0) {
+        emit warning("Camera JPEG frame is empty");
+        return QImage();
+    }
+
+#ifdef HAVE_JPEG
+    // Decode with a DCT scaling, so only 1 / _jpeg_scale_denom of the
+    // frame is reconstructed.
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager error_manager;
+    cinfo.err = jpeg_std_error(&error_manager.base);
+    error_manager.base.error_exit = jpegErrorExit;
+    error_manager.base.output_message = jpegOutputMessage;
+    if(setjmp(error_manager.jump_buffer)) {
+        jpeg_destroy_decompress(&cinfo);
+        emit warning("Camera JPEG frame can't be decoded");
+        return QImage();
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, const_cast<uchar*>(data), size);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = _jpeg_scale_denom;
+    cinfo.dct_method = JDCT_IFAST;
+    jpeg_start_decompress(&cinfo);
+
+    QImage& rgb_image = rgbBuffer(QSize(cinfo.output_width, cinfo.output_height));
+    while(cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = rgb_image.scanLine(cinfo.output_scanline);
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    updateFrameScale(static_cast<qreal>(rgb_image.width()) / frame.width());
+    return rgb_image;
+#else
+    // Without libjpeg, rely on the Qt JPEG plugin (which also scales in the
+    // DCT domain when a scaled size is requested).
+    QByteArray bytes = QByteArray::fromRawData((const char*) data, size);
+    QBuffer buffer(&bytes);
+    QImageReader reader(&buffer, "jpeg");
+    if(_jpeg_scale_denom > 1)
+        reader.setScaledSize(QSize(
+            (frame.width() + _jpeg_scale_denom - 1) / _jpeg_scale_denom,
+            (frame.height() + _jpeg_scale_denom - 1) / _jpeg_scale_denom
+        ));
+    QImage image = reader.read();
+    if(image.isNull()) {
+        emit warning("Camera JPEG frame can't be decoded");
+        return QImage();
+    }
+    updateFrameScale(static_cast<qreal>(image.width()) / frame.width());
+    return image;
+#endif
 }
 
 } // namespace laser_painter
\ No newline at end of file
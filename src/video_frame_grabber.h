@@ -2,8 +2,9 @@
 #define VIDEO_FRAME_GRABBER_H
 
 #include <QAbstractVideoSurface>
+#include <QImage>
+#include <QByteArray>
 
-class QImage;
 class QCamera;
 
 namespace laser_painter {
@@ -27,28 +28,59 @@ public:
 
 public slots:
     void installCamera(QCamera* camera);
-    void setFlipX(bool enabled);
-    void setFlipY(bool enabled);
+    /// Set the scale @param scale (<= 1) the frames are downscaled to by
+    /// the consumers. Compressed (JPEG) frames are then decoded directly at
+    /// a reduced resolution, but never below @param scale.
+    void setDecodeScale(qreal scale);
 
 signals:
+    /// Emitted before frameAvailable() with the time @param time the frame
+    /// was presented (QElapsedTimer::msecsSinceReference()).
+    void frameCaptured(qint64 time) const;
     /// Emit a new available frame image @param frame.
     void frameAvailable(const QImage& frame);
+    /// Emitted frames are scaled by @param scale (<= 1) relatively to the
+    /// camera resolution.
+    void frameScaleChanged(qreal scale) const;
 
     void warning(const QString& text) const;
 
 private:
-    // Convert frames with YUV color schemes with opencv
+    // Convert frames with YUV color schemes to RGB888 images with opencv
     // Supported formats:
-    // Format_YUV444
-    // Format_YUV420P
-    // Format_YV12
-    // Format_UYVY
-    // Format_YUYV
-    QImage YUVQVideoFrame2QImage(const QVideoFrame& frame) const;
+    // Format_AYUV444, Format_AYUV444_Premultiplied, Format_YUV444 (packed)
+    // Format_UYVY, Format_YUYV (packed 4:2:2)
+    // Format_YUV420P, Format_YV12, Format_IMC1, Format_IMC2, Format_IMC3,
+    // Format_IMC4 (planar 4:2:0)
+    // Format_NV12, Format_NV21 (semi-planar 4:2:0)
+    // The result is written into a reused buffer.
+    QImage YUVQVideoFrame2QImage(const QVideoFrame& frame);
+    // Decode Format_Jpeg frames (MJPEG cameras) into RGB888 images at 1 /
+    // _jpeg_scale_denom of the frame resolution.
+    QImage JpegQVideoFrame2QImage(const QVideoFrame& frame);
+    // Wrap Format_Y8 and Format_Y16 frames (monochrome cameras) into
+    // Format_Grayscale8 and Format_Grayscale16 images (Qt >= 5.13, otherwise
+    // Y16 is reduced to 8 bits).
+    QImage YQVideoFrame2QImage(const QVideoFrame& frame);
+    // Emit frameScaleChanged() if @param scale differs from the previous
+    // frame scale.
+    void updateFrameScale(qreal scale);
+    // Return the RGB888 buffer of size @param size, reuse the previous one
+    // if nobody else holds it.
+    QImage& rgbBuffer(const QSize& size);
+    // Return a contiguous staging buffer of @param size bytes.
+    uchar* stagingBuffer(int size);
 
 private:
-    bool _flip_x;
-    bool _flip_y;
+    // JPEG frames are decoded at 1 / _jpeg_scale_denom (1, 2, 4 or 8) of
+    // their resolution.
+    int _jpeg_scale_denom;
+    qreal _frame_scale;
+
+    QImage _rgb_buffer;
+    // Planes of YUV frames with a layout not supported by opencv are copied
+    // there.
+    QByteArray _yuv_staging;
 };
 
 } // namespace laser_painter